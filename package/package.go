@@ -36,8 +36,13 @@ func GetPackage() *denv.Package {
 	maintest.AddDependency(testlib)
 	maintest.AddDependencies(cunittestpkg.GetMainLib()...)
 
+	// benchmark program, source/benchmark/cpp, writes its results as JSON lines to stdout
+	benchapp := denv.SetupCppAppProject(mainpkg, name+"_benchmark", "benchmark")
+	benchapp.AddDependency(mainlib)
+
 	mainpkg.AddMainLib(mainlib)
 	mainpkg.AddTestLib(testlib)
 	mainpkg.AddUnittest(maintest)
+	mainpkg.AddMainApp(benchapp)
 	return mainpkg
 }
@@ -0,0 +1,62 @@
+#ifndef __C_VMEM_BENCHMARK_H__
+#define __C_VMEM_BENCHMARK_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cvmem/c_virtual_memory.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        // Benchmark settings, set from the command line.
+        struct config_t
+        {
+            s32         repeat; // every measurement is repeated this many times, the fastest run is reported
+            const char* filter; // only run suites whose name contains this string (nullptr = all)
+        };
+
+        extern config_t gConfig;
+
+        // Written to by the benchmarks so that the compiler cannot optimize the measured work away.
+        extern void* volatile gSink;
+
+        // Emit one result as a single line of JSON on stdout, e.g.
+        // {"suite":"arena","name":"ArenaPush","bytes":64,"ops":100000,"ns":412345,"ns_per_op":4.123}
+        void report(const char* suite, const char* name, u64 bytes, u64 ops, u64 ns);
+
+        // @returns true when the suite passes the filter.
+        bool enabled(const char* suite);
+
+        // Run `setup`, `run` and `reset` gConfig.repeat times, only `run` is timed.
+        // @returns the fastest time of `run` in nanoseconds.
+        template <typename S, typename R, typename C> u64 measure(S setup, R run, C reset)
+        {
+            u64 best = ~(u64)0;
+            for (s32 i = 0; i < gConfig.repeat; ++i)
+            {
+                setup();
+                u64 const t0 = nvmem::query_time_ns();
+                run();
+                u64 const t1 = nvmem::query_time_ns();
+                reset();
+                if ((t1 - t0) < best)
+                    best = t1 - t0;
+            }
+            return best;
+        }
+
+        inline void nothing() {}
+
+        // Suites
+        void bench_memory();
+        void bench_arena();
+        void bench_pool();
+        void bench_array();
+
+    } // namespace nbench
+} // namespace ncore
+
+#endif // __C_VMEM_BENCHMARK_H__
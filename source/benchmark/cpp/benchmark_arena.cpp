@@ -0,0 +1,129 @@
+#include "ccore/c_target.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_arena.h"
+#include "benchmark.h"
+
+#include <stdlib.h>
+
+namespace ncore
+{
+    namespace nbench
+    {
+        static const s32 cArenaOps = 100000;
+        static void*     sArenaPtrs[cArenaOps];
+
+        // Push, aligned push and pop on an arena that is fully commited up front, so only the bookkeeping is measured,
+        // compared against malloc and a plain pointer bump over the same memory.
+        void bench_arena()
+        {
+            ArenasSetup();
+
+            s32 const   sizes[]  = {16, 64, 256};
+            int_t const reserved = 256 * cMB;
+            arena_t*    arena    = ArenaAlloc(reserved, reserved);
+            if (arena == nullptr)
+            {
+                ArenasTeardown();
+                return;
+            }
+
+            for (s32 size : sizes)
+            {
+                u64 const bytes = (u64)size * cArenaOps;
+
+                u64 ns = measure(
+                  nothing,
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          gSink = ArenaPush(arena, size);
+                  },
+                  [&]() { ArenaPopTo(arena, 0); });
+                report("arena", "ArenaPush", bytes, cArenaOps, ns);
+
+                ns = measure(
+                  nothing,
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          gSink = ArenaPushAligned(arena, size, 64);
+                  },
+                  [&]() { ArenaPopTo(arena, 0); });
+                report("arena", "ArenaPushAligned(64)", bytes, cArenaOps, ns);
+
+                ns = measure(
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          ArenaPush(arena, size);
+                  },
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          ArenaPopTo(arena, ArenaPos(arena) - size);
+                  },
+                  [&]() { ArenaPopTo(arena, 0); });
+                report("arena", "ArenaPopTo", bytes, cArenaOps, ns);
+
+                ns = measure(
+                  nothing,
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          gSink = ArenaPushConcurrent(arena, size);
+                  },
+                  [&]() { ArenaPopTo(arena, 0); });
+                report("arena", "ArenaPushConcurrent", bytes, cArenaOps, ns);
+
+                // the lower bound, a pointer bump without any checks
+                ns = measure(
+                  nothing,
+                  [&]() {
+                      u8* ptr = arena->Mem;
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                      {
+                          gSink = ptr;
+                          ptr += size;
+                      }
+                  },
+                  nothing);
+                report("arena", "bump", bytes, cArenaOps, ns);
+
+                ns = measure(
+                  nothing,
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          sArenaPtrs[i] = ::malloc(size);
+                  },
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          ::free(sArenaPtrs[i]);
+                  });
+                report("arena", "malloc", bytes, cArenaOps, ns);
+
+                ns = measure(
+                  [&]() {
+                      for (s32 i = 0; i < cArenaOps; ++i)
+                          sArenaPtrs[i] = ::malloc(size);
+                  },
+                  [&]() {
+                      for (s32 i = cArenaOps - 1; i >= 0; --i)
+                          ::free(sArenaPtrs[i]);
+                  },
+                  nothing);
+                report("arena", "free", bytes, cArenaOps, ns);
+            }
+
+            // growing a fresh arena page by page, this includes the commit calls and the page faults
+            u32 const page_size = nvmem::get_page_size();
+            u64 const ns        = measure(
+              [&]() { ArenaClear(arena, 0); },
+              [&]() {
+                  for (s32 i = 0; i < 4096; ++i)
+                      *(u8*)ArenaPush(arena, page_size) = 1;
+              },
+              [&]() { ArenaClear(arena, 0); });
+            report("arena", "ArenaPush(grow+touch)", (u64)page_size * 4096, 4096, ns);
+
+            ArenaRelease(arena);
+            ArenasTeardown();
+        }
+
+    } // namespace nbench
+} // namespace ncore
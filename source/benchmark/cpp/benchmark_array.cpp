@@ -0,0 +1,72 @@
+#include "ccore/c_target.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_array.h"
+#include "benchmark.h"
+
+#include <vector>
+
+namespace ncore
+{
+    namespace nbench
+    {
+        static const u32 cArrayOps = 1000000;
+        static u64       sArrayItems[1024];
+
+        // Filling an array from empty, the array commits pages as it grows where a vector reallocates and copies.
+        void bench_array()
+        {
+            u64 const bytes = (u64)sizeof(u64) * cArrayOps;
+
+            nvmem::array_t<u64> array;
+            if (!array.setup(0, cArrayOps))
+                return;
+
+            u64 ns = measure(
+              nothing,
+              [&]() {
+                  for (u32 i = 0; i < cArrayOps; ++i)
+                      array.push_back(i);
+              },
+              [&]() {
+                  array.clear();
+                  array.shrink_to_fit();
+              });
+            report("array", "array_t::push_back", bytes, cArrayOps, ns);
+
+            ns = measure(
+              nothing,
+              [&]() {
+                  for (u32 i = 0; i < cArrayOps; i += 1024)
+                      array.append(sArrayItems, 1024 < (cArrayOps - i) ? 1024 : (cArrayOps - i));
+              },
+              [&]() {
+                  array.clear();
+                  array.shrink_to_fit();
+              });
+            report("array", "array_t::append(1024)", bytes, cArrayOps, ns);
+
+            std::vector<u64>* vector = nullptr;
+            ns                       = measure(
+              [&]() { vector = new std::vector<u64>(); },
+              [&]() {
+                  for (u32 i = 0; i < cArrayOps; ++i)
+                      vector->push_back(i);
+              },
+              [&]() { delete vector; });
+            report("array", "std::vector::push_back", bytes, cArrayOps, ns);
+
+            ns = measure(
+              [&]() { vector = new std::vector<u64>(); },
+              [&]() {
+                  for (u32 i = 0; i < cArrayOps; i += 1024)
+                      vector->insert(vector->end(), sArrayItems, sArrayItems + (1024 < (cArrayOps - i) ? 1024 : (cArrayOps - i)));
+              },
+              [&]() { delete vector; });
+            report("array", "std::vector::insert(1024)", bytes, cArrayOps, ns);
+
+            array.teardown();
+        }
+
+    } // namespace nbench
+} // namespace ncore
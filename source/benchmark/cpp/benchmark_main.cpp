@@ -0,0 +1,77 @@
+#include "ccore/c_target.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Microbenchmarks of cvmem, results are written to stdout as JSON lines (one object per line) so that runs of
+// different releases can be compared by a script.
+//
+// usage: cvmem_benchmark [--repeat <count>] [--filter <suite>]
+//   --repeat   number of times every measurement is repeated, the fastest run is reported (default: 5)
+//   --filter   only run the suites whose name contains this string (memory, arena, pool, array)
+
+namespace ncore
+{
+    namespace nbench
+    {
+        config_t       gConfig = {5, nullptr};
+        void* volatile gSink   = nullptr;
+
+        void report(const char* suite, const char* name, u64 bytes, u64 ops, u64 ns)
+        {
+            double const ns_per_op = ops > 0 ? (double)ns / (double)ops : 0.0;
+            printf("{\"suite\":\"%s\",\"name\":\"%s\",\"bytes\":%llu,\"ops\":%llu,\"ns\":%llu,\"ns_per_op\":%.3f}\n", suite, name, (unsigned long long)bytes, (unsigned long long)ops, (unsigned long long)ns, ns_per_op);
+            fflush(stdout);
+        }
+
+        bool enabled(const char* suite) { return gConfig.filter == nullptr || strstr(suite, gConfig.filter) != nullptr; }
+
+    } // namespace nbench
+} // namespace ncore
+
+using namespace ncore;
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--repeat") == 0 && (i + 1) < argc)
+        {
+            nbench::gConfig.repeat = atoi(argv[++i]);
+            if (nbench::gConfig.repeat < 1)
+                nbench::gConfig.repeat = 1;
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && (i + 1) < argc)
+        {
+            nbench::gConfig.filter = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--repeat <count>] [--filter <suite>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!nvmem::initialize())
+    {
+        fprintf(stderr, "failed to initialize nvmem\n");
+        return 1;
+    }
+
+    printf("{\"benchmark\":\"cvmem\",\"page_size\":%u,\"repeat\":%d}\n", nvmem::get_page_size(), nbench::gConfig.repeat);
+
+    if (nbench::enabled("memory"))
+        nbench::bench_memory();
+    if (nbench::enabled("arena"))
+        nbench::bench_arena();
+    if (nbench::enabled("pool"))
+        nbench::bench_pool();
+    if (nbench::enabled("array"))
+        nbench::bench_array();
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "ccore/c_target.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "benchmark.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        // Cost of the raw virtual memory primitives across range sizes, every size is done on a fresh part of one
+        // big reservation and every call covers the whole range.
+        void bench_memory()
+        {
+            u64 const reserved = 1 * cGB;
+            void*     baseptr  = nullptr;
+            if (!nvmem::reserve(reserved, nvmem::nprotect::ReadWrite, baseptr))
+                return;
+
+            u32 const page_size = nvmem::get_page_size();
+            u64 const sizes[]   = {(u64)page_size, 64 * cKB, 1 * cMB, 16 * cMB, 64 * cMB};
+
+            for (u64 size : sizes)
+            {
+                u8* const mem = (u8*)baseptr;
+
+                // commit of pages that are not backed yet, page faults are paid later on first touch
+                u64 ns = measure(nothing, [&]() { nvmem::commit(mem, size); }, [&]() { nvmem::decommit(mem, size); });
+                report("memory", "commit", size, 1, ns);
+
+                // commit and touching every page, this is what a user of the memory pays
+                ns = measure(
+                  nothing,
+                  [&]() {
+                      nvmem::commit(mem, size);
+                      for (u64 i = 0; i < size; i += page_size)
+                          mem[i] = 1;
+                  },
+                  [&]() { nvmem::decommit(mem, size); });
+                report("memory", "commit+touch", size, size / page_size, ns);
+
+                // commit that populates the pages up front, large sizes are populated by several threads
+                ns = measure(nothing, [&]() { nvmem::commit_populate(mem, size); }, [&]() { nvmem::decommit(mem, size); });
+                report("memory", "commit+populate", size, size / page_size, ns);
+
+                // decommit of pages that were touched, so they are backed by physical memory
+                ns = measure(
+                  [&]() {
+                      nvmem::commit(mem, size);
+                      for (u64 i = 0; i < size; i += page_size)
+                          mem[i] = 1;
+                  },
+                  [&]() { nvmem::decommit(mem, size); }, nothing);
+                report("memory", "decommit", size, 1, ns);
+
+                // protect a commited range read-only and back
+                nvmem::commit(mem, size);
+                ns = measure(
+                  nothing,
+                  [&]() {
+                      nvmem::protect(mem, (nvmem::int_t)size, nvmem::nprotect::Read);
+                      nvmem::protect(mem, (nvmem::int_t)size, nvmem::nprotect::ReadWrite);
+                  },
+                  nothing);
+                report("memory", "protect", size, 2, ns);
+                nvmem::decommit(mem, size);
+            }
+
+            // reserve and release of address space only
+            u64 const ns = measure(
+              nothing,
+              [&]() {
+                  void* ptr = nullptr;
+                  if (nvmem::reserve(reserved, nvmem::nprotect::ReadWrite, ptr))
+                      nvmem::release(ptr, reserved);
+              },
+              nothing);
+            report("memory", "reserve+release", reserved, 1, ns);
+
+            nvmem::release(baseptr, reserved);
+        }
+
+    } // namespace nbench
+} // namespace ncore
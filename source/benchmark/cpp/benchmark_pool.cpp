@@ -0,0 +1,178 @@
+#include "ccore/c_target.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_pool.h"
+#include "cvmem/c_virtual_pool_concurrent.h"
+#include "benchmark.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        static const s32 cPoolOps = 100000;
+        static void*     sPoolPtrs[cPoolOps];
+
+        template <s32 S> struct item_t
+        {
+            u8 m_data[S];
+        };
+
+        // Allocate and free of a pool with all items commited up front against new and delete of the same type.
+        template <typename P, typename T> static void bench_pool_type(const char* alloc_name, const char* free_name, P& pool)
+        {
+            u64 const bytes = (u64)sizeof(T) * cPoolOps;
+
+            u64 ns = measure(
+              nothing,
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      sPoolPtrs[i] = pool.allocate();
+              },
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      pool.deallocate((T*)sPoolPtrs[i]);
+              });
+            report("pool", alloc_name, bytes, cPoolOps, ns);
+
+            ns = measure(
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      sPoolPtrs[i] = pool.allocate();
+              },
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      pool.deallocate((T*)sPoolPtrs[i]);
+              },
+              nothing);
+            report("pool", free_name, bytes, cPoolOps, ns);
+        }
+
+        // The same through allocate_n and deallocate_n, in batches of 64 items.
+        template <typename T> static void bench_pool_batch(nvmem::pool_t<T>& pool)
+        {
+            u64 const bytes = (u64)sizeof(T) * cPoolOps;
+            T** const items = (T**)sPoolPtrs;
+
+            u64 ns = measure(
+              nothing,
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; i += 64)
+                      pool.allocate_n(items + i, (cPoolOps - i) < 64 ? (cPoolOps - i) : 64);
+              },
+              [&]() { pool.deallocate_n(items, cPoolOps); });
+            report("pool", "pool_t::allocate_n", bytes, cPoolOps, ns);
+
+            ns = measure(
+              [&]() { pool.allocate_n(items, cPoolOps); },
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; i += 64)
+                      pool.deallocate_n(items + i, (cPoolOps - i) < 64 ? (cPoolOps - i) : 64);
+              },
+              nothing);
+            report("pool", "pool_t::deallocate_n", bytes, cPoolOps, ns);
+        }
+
+        template <typename T> static void bench_new_delete()
+        {
+            u64 const bytes = (u64)sizeof(T) * cPoolOps;
+
+            u64 ns = measure(
+              nothing,
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      sPoolPtrs[i] = new T;
+              },
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      delete (T*)sPoolPtrs[i];
+              });
+            report("pool", "new", bytes, cPoolOps, ns);
+
+            ns = measure(
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      sPoolPtrs[i] = new T;
+              },
+              [&]() {
+                  for (s32 i = 0; i < cPoolOps; ++i)
+                      delete (T*)sPoolPtrs[i];
+              },
+              nothing);
+            report("pool", "delete", bytes, cPoolOps, ns);
+        }
+
+        template <s32 S> static void bench_pool_size()
+        {
+            typedef item_t<S> T;
+
+            nvmem::pool_t<T> pool;
+            if (pool.setup(cPoolOps, cPoolOps))
+            {
+                bench_pool_type<nvmem::pool_t<T>, T>("pool_t::allocate", "pool_t::deallocate", pool);
+                pool.teardown();
+            }
+
+            nvmem::pool_t<T> batch;
+            if (batch.setup(cPoolOps, cPoolOps))
+            {
+                bench_pool_batch<T>(batch);
+                batch.teardown();
+            }
+
+            nvmem::cpool_t<T> cpool;
+            if (cpool.setup(cPoolOps, cPoolOps))
+            {
+                bench_pool_type<nvmem::cpool_t<T>, T>("cpool_t::allocate", "cpool_t::deallocate", cpool);
+                cpool.teardown();
+            }
+
+            bench_new_delete<T>();
+        }
+
+        // Visiting the live items of a pool with a quarter of the items free, through the occupancy bitmap against
+        // through a separate list of item indices.
+        static void bench_pool_iterate()
+        {
+            typedef item_t<64> T;
+
+            nvmem::pool_t<T> pool;
+            if (!pool.setup(cPoolOps, cPoolOps))
+                return;
+
+            static u32 sIndices[cPoolOps];
+            u32        count = 0;
+            for (s32 i = 0; i < cPoolOps; ++i)
+                pool.allocate()->m_data[0] = (u8)i;
+            for (s32 i = 0; i < cPoolOps; i += 4)
+                pool.deallocate(pool.ptr_at(i));
+            for (u32 i = pool.first_live(); i != pool.cInvalidIndex; i = pool.next_live(i))
+                sIndices[count++] = i;
+
+            u64 const bytes = (u64)sizeof(T) * count;
+            u64       sum   = 0;
+            u64       ns    = measure(nothing, [&]() { pool.for_each_live([&](T* item, u32) { sum += item->m_data[0]; }); }, nothing);
+            report("pool", "pool_t::for_each_live", bytes, count, ns);
+
+            ns = measure(
+              nothing,
+              [&]() {
+                  for (u32 i = 0; i < count; ++i)
+                      sum += pool.ptr_at(sIndices[i])->m_data[0];
+              },
+              nothing);
+            report("pool", "index list", bytes, count, ns);
+
+            gSink = (void*)(ptr_t)sum;
+            pool.teardown();
+        }
+
+        void bench_pool()
+        {
+            bench_pool_iterate();
+            bench_pool_size<16>();
+            bench_pool_size<64>();
+            bench_pool_size<256>();
+        }
+
+    } // namespace nbench
+} // namespace ncore
@@ -7,6 +7,15 @@
 
 #include "cvmem/c_virtual_memory.h"
 #include "cvmem/c_virtual_arena.h"
+#include "cvmem/c_virtual_reclaim.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
 
 #if !defined(TARGET_DEBUG)
 #    define VMEM_NO_ERROR_CHECKING
@@ -24,8 +33,11 @@ namespace ncore
         cArenaErrorShrink         = 4, // Failed to shrink the arena.
         cArenaErrorRelease        = 5, // Failed to release the arena.
         cArenaErrorAlignmentShift = 6, // Alignment shift must be between 0 and 16.
-        cArenaErrorPageSizeShift  = 7, // Page size shift must be between 12 and 20.
-        cArenaErrorMaxErrors      = 10,
+        cArenaErrorPageSizeShift  = 7, // Page size shift must be between 12 and 30.
+        cArenaErrorFile           = 8, // Failed to open, map or flush the file of a file-backed arena.
+        cArenaErrorSnapshot       = 9, // The arena is not file-backed or has no snapshot.
+        cArenaErrorDirty          = 10, // Failed to start dirty tracking or the arena is not tracked.
+        cArenaErrorMaxErrors      = 11,
     };
 
     static s64  gArenaErrorBase = 0;
@@ -41,7 +53,10 @@ namespace ncore
             case eArenaErrors::cArenaErrorShrink: return "failed to shrink the arena.";
             case eArenaErrors::cArenaErrorRelease: return "failed to release the arena.";
             case eArenaErrors::cArenaErrorAlignmentShift: return "alignment shift must be between 0 and 16.";
-            case eArenaErrors::cArenaErrorPageSizeShift: return "page size shift must be between 12 and 20.";
+            case eArenaErrors::cArenaErrorPageSizeShift: return "page size shift must be between 12 and 30.";
+            case eArenaErrors::cArenaErrorFile: return "failed to open, map or flush the file of the arena.";
+            case eArenaErrors::cArenaErrorSnapshot: return "the arena is not file-backed or has no snapshot.";
+            case eArenaErrors::cArenaErrorDirty: return "failed to start dirty tracking or the arena is not tracked.";
             default: return "unknown arena error";
         }
     }
@@ -80,23 +95,74 @@ namespace ncore
     }
 #endif
 
-    // arena_t (32 bytes) + zarena_t (32 bytes) = 64 bytes
+    // arena_t (32 bytes) + zarena_t (96 bytes) = 128 bytes
     struct zarena_t
     {
-        arena_t     Arena;
-        const char* Name;
-        zarena_t*   Next;
-        void*       Padding0;
-        void*       Padding1;
+        arena_t        Arena;
+        const char*    Name;
+        std::atomic<s32> Next;         // index + 1 of the next arena in the free list (0 = none)
+        std::atomic<s32> GrowLock;     // serializes growing the commited range for concurrent pushes
+        s32            MinCommitPages; // policy: minimum number of pages to commit when growing
+        s32            GrowthPercent;  // policy: grow by at least this percentage of the commited pages
+        s32            KeepPages;      // policy: low-water mark, never decommit below this number of pages
+        s16            DecommitDelay;  // policy: number of clears to observe before decommitting
+        s16            ClearCount;     // number of clears observed since the last decommit
+        s32            PeakPages;      // peak number of pages in use over the observed clears
+        s32            PeakCommited;   // telemetry: peak number of commited pages
+        int_t          PoppedBytes;    // telemetry: bytes popped over the lifetime, bytes pushed = PoppedBytes + Pos
+        int_t          PeakPos;        // telemetry: peak position, only updated when the position goes down (see ArenaTrackPop)
+        nvmem::stats_t Stats;          // telemetry: commit and decommit calls
+        union
+        {
+            u64           ReclaimTicket; // ticket of the last decommit handed to the background reclaimer (0 = none)
+            nvmem::file_t File;          // ARENA_FLAG_FILE: the mapped file, file-backed arenas don't use the reclaimer
+            int_t         PosBack;       // ARENA_FLAG_DOUBLE_ENDED: bytes in use at the back, these arenas don't use the reclaimer
+        };
+    };
+    static_assert(sizeof(zarena_t) == 128, "zarena_t should be 128 bytes");
+
+    // Header in the first page of the file of a file-backed arena, the arena memory starts at the second page.
+    struct zarena_file_t
+    {
+        u32   Magic;          // cArenaFileMagic
+        u32   Version;        // cArenaFileVersion
+        u64   Base;           // address of the arena memory when the file was last flushed or released
+        int_t Pos;            // position of the arena when the file was last flushed or released
+        s32   ReservedPages;  // reserved size of the arena in pages, not counting the header page
+        s8    PageSizeShift;  // page size of the arena, the header page is one page
+        s8    AlignmentShift; // minimum alignment of the arena
+        s8    Snapshot;       // 1 while a snapshot is taken, the file then holds the snapshot and Pos is its position
+        s8    Dummy;
+        s32   SnapshotPages;  // commited pages of the arena when the snapshot was taken
     };
 
+    static const u32 cArenaFileMagic   = 0x616d7663; // 'cvma'
+    static const u32 cArenaFileVersion = 1;
+
+    // The concurrent functions operate on the plain arena_t fields that the other functions use directly,
+    // through the atomic builtins of the compiler on those fields.
+#if defined(_MSC_VER)
+    static_assert(sizeof(int_t) == sizeof(__int64) && sizeof(s32) == sizeof(long), "int_t must be 64-bit and s32 must be a long");
+    static inline int_t AtomicAddPos(arena_t* arena, int_t delta) { return (int_t)_InterlockedExchangeAdd64((volatile __int64*)&arena->Pos, (__int64)delta); }
+    static inline s32   AtomicLoadCommited(arena_t* arena) { return (s32)_InterlockedOr((volatile long*)&arena->CapacityCommited, 0); }
+    static inline void  AtomicStoreCommited(arena_t* arena, s32 pages) { _InterlockedExchange((volatile long*)&arena->CapacityCommited, (long)pages); }
+#else
+    static inline int_t AtomicAddPos(arena_t* arena, int_t delta) { return __atomic_fetch_add(&arena->Pos, delta, __ATOMIC_RELAXED); }
+    static inline s32   AtomicLoadCommited(arena_t* arena) { return __atomic_load_n(&arena->CapacityCommited, __ATOMIC_ACQUIRE); }
+    static inline void  AtomicStoreCommited(arena_t* arena, s32 pages) { __atomic_store_n(&arena->CapacityCommited, pages, __ATOMIC_RELEASE); }
+#endif
+
     static inline int_t CommittedInBytes(arena_t const& Arena)
     {
-        return Arena.CapacityCommited << Arena.PageSizeShift; // Capacity in bytes
+        return (int_t)Arena.CapacityCommited << Arena.PageSizeShift; // Capacity in bytes
     }
     static inline int_t ReservedInBytes(arena_t const& Arena)
     {
-        return Arena.CapacityReserved << Arena.PageSizeShift; // Capacity in bytes
+        return (int_t)Arena.CapacityReserved << Arena.PageSizeShift; // Capacity in bytes
+    }
+    static inline int_t CommittedBackInBytes(arena_t const& Arena)
+    {
+        return (int_t)Arena.CapacityCommitedBack << Arena.PageSizeShift; // Capacity of the back stack in bytes
     }
     static inline int_t AlignToPageSize(arena_t const& Arena, int_t size) { return math::g_alignUp<int_t>(size, (int_t)1 << Arena.PageSizeShift); }
     static inline int_t NumBytesToPages(arena_t const& Arena, int_t sizeInByes) { return math::g_alignUp<int_t>(sizeInByes, (int_t)1 << Arena.PageSizeShift) >> Arena.PageSizeShift; }
@@ -104,41 +170,127 @@ namespace ncore
     {
         return numPages << Arena.PageSizeShift; // Convert pages to bytes
     }
+    // The stacks of a double-ended arena meet at page granularity, each can use the pages that the other one doesn't.
+    static inline s32 FrontLimitInPages(arena_t const& Arena)
+    {
+        if ((Arena.Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
+            return Arena.CapacityReserved;
+        return Arena.CapacityReserved - (s32)NumBytesToPages(Arena, ((zarena_t const&)Arena).PosBack);
+    }
+    static inline s32 BackLimitInPages(arena_t const& Arena) { return Arena.CapacityReserved - (s32)NumBytesToPages(Arena, Arena.Pos); }
 
+    // Registry of arena slots, ArenaAlloc and ArenaRelease can be called from any thread.
+    // Released slots go on a lock-free free list with a tagged head (slot index + 1 in the low 32 bits, tag in the high
+    // 32 bits) to make it ABA-safe, new slots are taken with an atomic bump of the free index and the commited part of
+    // the slot array grows with idempotent commits behind an atomic watermark (m_arena_max_index).
     struct zarena_system_t
     {
         void reset()
         {
-            m_array      = {0};
-            m_arena_max_index  = 0;
-            m_arena_free_index = 0;
-            m_arena_free_head  = nullptr;
+            m_array = {0};
+            m_arena_cap_index = 0;
+            m_array_commited.store(0, std::memory_order_relaxed);
+            m_arena_max_index.store(0, std::memory_order_relaxed);
+            m_arena_free_index.store(0, std::memory_order_relaxed);
+            m_arena_free_head.store(0, std::memory_order_relaxed);
         }
 
-        arena_t   m_array;
-        s32       m_arena_cap_index;
-        s32       m_arena_max_index;
-        s32       m_arena_free_index;
-        zarena_t* m_arena_free_head;
+        arena_t          m_array;
+        s32              m_arena_cap_index;  // number of slots that fit in the reserved range
+        std::atomic<s32> m_array_commited;   // number of pages of the slot array that are commited
+        std::atomic<s32> m_arena_max_index;  // number of slots that are commited
+        std::atomic<s32> m_arena_free_index; // index of the first never used slot
+        std::atomic<u64> m_arena_free_head;  // tagged head of the free list of slots
     };
 
-    static zarena_system_t sArenas = {0};
+    static zarena_system_t sArenas;
 
     static inline s32 gArenaPtrToIndex(const zarena_t* arena)
     {
         if (arena == nullptr)
             return -1;
-        return (s32)(arena - (const zarena_t*)sArenas.m_array.Mem) / sizeof(zarena_t);
+        return (s32)(arena - (const zarena_t*)sArenas.m_array.Mem);
     }
 
     static inline zarena_t* gArenaIndexToPtr(s32 index)
     {
-        if (index < 0 || index >= sArenas.m_arena_free_index)
+        if (index < 0 || index >= sArenas.m_arena_cap_index)
             return nullptr;
         zarena_t* arenaArray = (zarena_t*)sArenas.m_array.Mem;
         return &arenaArray[index];
     }
 
+    // Make sure slot `index` is commited, grows the commited slot array by 12.5% at a time.
+    static bool gArenaCommitSlot(s32 index)
+    {
+        s32 max_index = sArenas.m_arena_max_index.load(std::memory_order_acquire);
+        if (index < max_index)
+            return true;
+
+        const s32   addIndices     = math::g_clamp<s32>(max_index >> 3, 1, sArenas.m_arena_cap_index);
+        const s32   targetIndex    = math::g_min<s32>(math::g_max<s32>(index + 1, max_index + addIndices), sArenas.m_arena_cap_index);
+        const int_t commitedPages  = NumBytesToPages(sArenas.m_array, (int_t)(max_index * sizeof(zarena_t)));
+        const int_t targetPages    = math::g_min<int_t>(NumBytesToPages(sArenas.m_array, (int_t)(targetIndex * sizeof(zarena_t))), sArenas.m_array.CapacityReserved);
+        const s32   targetMaxIndex = (s32)math::g_min<int_t>(NumPagesToBytes(sArenas.m_array, targetPages) / sizeof(zarena_t), sArenas.m_arena_cap_index);
+        if (targetPages > commitedPages)
+        {
+            // Commit is idempotent, threads racing to commit the same pages is harmless
+            const int_t commitedBytes = NumPagesToBytes(sArenas.m_array, commitedPages);
+            if (!nvmem::commit(sArenas.m_array.Mem + commitedBytes, NumPagesToBytes(sArenas.m_array, targetPages) - commitedBytes))
+                return false;
+
+            s32 commited = sArenas.m_array_commited.load(std::memory_order_relaxed);
+            while (commited < (s32)targetPages && !sArenas.m_array_commited.compare_exchange_weak(commited, (s32)targetPages, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        while (max_index < targetMaxIndex && !sArenas.m_arena_max_index.compare_exchange_weak(max_index, targetMaxIndex, std::memory_order_release, std::memory_order_acquire))
+        {
+        }
+        return true;
+    }
+
+    static zarena_t* gArenaSlotAlloc()
+    {
+        // Pop a released slot from the free list
+        u64 head = sArenas.m_arena_free_head.load(std::memory_order_acquire);
+        while ((u32)head != 0)
+        {
+            zarena_t* zarena = gArenaIndexToPtr((s32)(u32)head - 1);
+            const s32 next   = zarena->Next.load(std::memory_order_relaxed);
+            if (sArenas.m_arena_free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | (u32)next, std::memory_order_acquire, std::memory_order_acquire))
+                return zarena;
+        }
+
+        // Take a never used slot
+        const s32 index = sArenas.m_arena_free_index.fetch_add(1, std::memory_order_relaxed);
+        if (index >= sArenas.m_arena_cap_index)
+        {
+            sArenas.m_arena_free_index.fetch_sub(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        if (!gArenaCommitSlot(index))
+        {
+            arena_error(cArenaErrorCommitMemory);
+            return nullptr; // the slot index is lost, the slot array can't be commited anyway
+        }
+        return gArenaIndexToPtr(index);
+    }
+
+    static void gArenaSlotFree(zarena_t* zarena)
+    {
+        const u32 slot = (u32)gArenaPtrToIndex(zarena) + 1;
+        u64       head = sArenas.m_arena_free_head.load(std::memory_order_relaxed);
+        do
+        {
+            zarena->Next.store((s32)(u32)head, std::memory_order_relaxed);
+        } while (!sArenas.m_arena_free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | slot, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Incremented by every ArenasSetup, scratch arenas created under an older setup are no longer valid.
+    static s32 sArenasGeneration = 0;
+
     void ArenasSetup(s32 init_num_arenas, s32 max_num_arenas, s8 default_alignment_shift, s8 default_page_size_shift)
     {
         if (sArenas.m_array.Mem == nullptr)
@@ -150,7 +302,7 @@ namespace ncore
             {
                 const u32 page_size       = nvmem::query_page_size(); // Initialize the page size query
                 const s8  page_size_shift = math::g_ilog2(page_size);
-                default_page_size_shift   = math::g_clamp<s8>(default_page_size_shift, page_size_shift, 20);
+                default_page_size_shift   = math::g_clamp<s8>(default_page_size_shift, page_size_shift, 30);
                 default_alignment_shift   = math::g_clamp<s8>(default_alignment_shift, 2, 16);
             }
 
@@ -172,18 +324,20 @@ namespace ncore
             const int_t commit_num_bytes = NumPagesToBytes(sArenas.m_array, commit_num_pages);
             if (!nvmem::commit(arena_mem_ptr, commit_num_bytes))
             {
-                nvmem::release(arena_mem_ptr, max_num_arenas * sizeof(zarena_t));
+                nvmem::release(arena_mem_ptr, reserve_num_bytes);
                 arena_error(cArenaErrorCommitMemory);
                 return;
             }
 
+            sArenasGeneration += 1;
+
             sArenas.m_array.CapacityReserved = reserve_num_pages;
-            sArenas.m_array.CapacityCommited = commit_num_pages;
             sArenas.m_array.Mem              = (u8*)arena_mem_ptr;
-            sArenas.m_arena_cap_index              = NumPagesToBytes(sArenas.m_array, sArenas.m_array.CapacityReserved) / sizeof(zarena_t);
-            sArenas.m_arena_max_index              = init_num_arenas; // Maximum number of arena objects we can have
-            sArenas.m_arena_free_index             = 0;               // Index of the next free arena in the array
-            sArenas.m_arena_free_head              = nullptr;         // Head of the free list of arenas
+            sArenas.m_arena_cap_index        = (s32)(NumPagesToBytes(sArenas.m_array, sArenas.m_array.CapacityReserved) / sizeof(zarena_t));
+            sArenas.m_array_commited.store(commit_num_pages, std::memory_order_relaxed);                            // Number of pages of the slot array that are commited
+            sArenas.m_arena_max_index.store((s32)(commit_num_bytes / sizeof(zarena_t)), std::memory_order_relaxed); // Number of arena objects that are commited
+            sArenas.m_arena_free_index.store(0, std::memory_order_relaxed);                                        // Index of the next free arena in the array
+            sArenas.m_arena_free_head.store(0, std::memory_order_relaxed);                                         // Head of the free list of arenas
         }
     }
 
@@ -191,7 +345,12 @@ namespace ncore
     {
         if (sArenas.m_array.Mem != nullptr)
         {
-            nvmem::decommit(sArenas.m_array.Mem, NumPagesToBytes(sArenas.m_array, sArenas.m_array.CapacityCommited));
+            ScratchRelease();
+
+            // arenas released in the background free their slot when the reclaimer is done with them
+            nvmem::reclaim_flush();
+
+            nvmem::decommit(sArenas.m_array.Mem, NumPagesToBytes(sArenas.m_array, sArenas.m_array_commited.load(std::memory_order_relaxed)));
             nvmem::release(sArenas.m_array.Mem, NumPagesToBytes(sArenas.m_array, sArenas.m_array.CapacityReserved));
             sArenas.reset();
         }
@@ -209,95 +368,441 @@ namespace ncore
         return zarena->Name;
     }
 
-    arena_t* ArenaAlloc(int_t reserved_size_in_bytes, int_t commit_size_in_bytes, s8 alignment_shift, s8 page_size_shift)
+    // Size of the NoAccess page that follows the reservation of an arena with ARENA_FLAG_GUARD.
+    static inline int_t ArenaGuardBytes(arena_t const& arena) { return (arena.Flags & ARENA_FLAG_GUARD) != 0 ? NumPagesToBytes(arena, 1) : 0; }
+
+    // Commit and, for arenas with ARENA_FLAG_PREFAULT, populate the pages.
+    static inline bool ArenaCommitPages(arena_t const* arena, u8* address, int_t size, nvmem::stats_t& stats)
+    {
+        if (!nvmem::commit(address, size, stats))
+            return false;
+        return (arena->Flags & ARENA_FLAG_PREFAULT) == 0 || nvmem::populate(address, size);
+    }
+
+    // Take a slot for `arena` and reset its name, policy and telemetry.
+    static zarena_t* ArenaNewSlot(arena_t const& arena, nvmem::stats_t const& stats)
+    {
+        zarena_t* zarena = gArenaSlotAlloc();
+        if (zarena == nullptr)
+            return nullptr;
+
+        zarena->Name           = "none";
+        zarena->Next.store(0, std::memory_order_relaxed);
+        zarena->GrowLock.store(0, std::memory_order_relaxed);
+        zarena->MinCommitPages = 0;
+        zarena->GrowthPercent  = 0;
+        zarena->KeepPages      = 0;
+        zarena->DecommitDelay  = 0;
+        zarena->ClearCount     = 0;
+        zarena->PeakPages      = 0;
+        zarena->PeakCommited   = arena.CapacityCommited;
+        zarena->PoppedBytes    = 0;
+        zarena->PeakPos        = 0;
+        zarena->Stats          = stats;
+        zarena->ReclaimTicket  = 0;
+        zarena->Arena          = arena;
+        return zarena;
+    }
+
+    // Dirty tracking of arenas with ARENA_FLAG_DIRTY, a bit per page of the reservation. A page that is writable is
+    // always marked dirty, clean pages are write-protected and the fault of the first store marks them dirty.
+    // The fault handler only reads the entries, an entry is published by storing Arena after Bits is set. The bits of an
+    // entry are released once the handlers that could still see the entry have returned (see sArenaDirtyFaults).
+    struct zarena_dirty_t
+    {
+        std::atomic<arena_t*> Arena;     // the tracked arena, nullptr when the entry is free
+        std::atomic<u64>*     Bits;      // dirty bit per page, set = the page is dirty and writable
+        u64                   BitsRange; // size of the reservation holding the bits
+    };
+
+    static zarena_dirty_t   sArenaDirty[ARENA_DIRTY_MAX];
+    static std::atomic<s32> sArenaDirtyLock(0);   // serializes taking and freeing entries
+    static std::atomic<s32> sArenaDirtyFaults(0); // number of fault handlers that are running
+
+    static void ArenaDirtyLock()
+    {
+        s32 unlocked = 0;
+        while (!sArenaDirtyLock.compare_exchange_weak(unlocked, 1, std::memory_order_acquire))
+        {
+            unlocked = 0;
+            std::this_thread::yield();
+        }
+    }
+    static void ArenaDirtyUnlock() { sArenaDirtyLock.store(0, std::memory_order_release); }
+
+    static zarena_dirty_t* ArenaDirtyEntry(arena_t const* arena)
+    {
+        for (s32 i = 0; i < ARENA_DIRTY_MAX; ++i)
+        {
+            if (sArenaDirty[i].Arena.load(std::memory_order_acquire) == arena)
+                return &sArenaDirty[i];
+        }
+        return nullptr;
+    }
+
+    // Mark pages [firstPage, endPage) dirty or clean, this does not change the protection of the pages.
+    static void ArenaDirtyMark(arena_t const* arena, s32 firstPage, s32 endPage, bool dirty)
+    {
+        zarena_dirty_t* entry = ArenaDirtyEntry(arena);
+        if (entry == nullptr)
+            return;
+        while (firstPage < endPage)
+        {
+            const s32 count = math::g_min<s32>(endPage - firstPage, 64 - (firstPage & 63));
+            const u64 mask  = (count == 64 ? ~(u64)0 : (((u64)1 << count) - 1)) << (firstPage & 63);
+            if (dirty)
+                entry->Bits[firstPage >> 6].fetch_or(mask, std::memory_order_release);
+            else
+                entry->Bits[firstPage >> 6].fetch_and(~mask, std::memory_order_release);
+            firstPage += count;
+        }
+    }
+
+    // Write-protect the commited pages that are not marked dirty, after something made all of them writable.
+    static void ArenaDirtyProtectClean(arena_t* arena)
+    {
+        zarena_dirty_t* entry = ArenaDirtyEntry(arena);
+        if (entry == nullptr)
+            return;
+        s32 runBegin = 0;
+        for (s32 page = 0; page <= arena->CapacityCommited; ++page)
+        {
+            const bool clean = page < arena->CapacityCommited && (entry->Bits[page >> 6].load(std::memory_order_relaxed) & ((u64)1 << (page & 63))) == 0;
+            if (clean)
+                continue;
+            if (page > runBegin)
+                nvmem::protect(arena->Mem + NumPagesToBytes(*arena, runBegin), NumPagesToBytes(*arena, page - runBegin), nvmem::nprotect::Read);
+            runBegin = page + 1;
+        }
+    }
+
+    // Called on a store to a page that is not writable, in a signal handler on POSIX.
+    // A store to the commited range of a tracked arena makes the page writable before it marks it dirty, whatever its
+    // bit says: a checkpoint clears the bits before it write-protects the pages, so the bit of a page that faults can
+    // already be set again by another thread.
+    static bool ArenaDirtyFaultEntry(void* address)
+    {
+        for (s32 i = 0; i < ARENA_DIRTY_MAX; ++i)
+        {
+            zarena_dirty_t* entry = &sArenaDirty[i];
+            arena_t*        arena = entry->Arena.load();
+            if (arena == nullptr)
+                continue;
+            const int_t offset = (int_t)((u8*)address - arena->Mem);
+            if ((u8*)address < arena->Mem || offset >= NumPagesToBytes(*arena, AtomicLoadCommited(arena)))
+                continue;
+
+            const s32 page = (s32)(offset >> arena->PageSizeShift);
+            if (!nvmem::protect(arena->Mem + NumPagesToBytes(*arena, page), NumPagesToBytes(*arena, 1), nvmem::nprotect::ReadWrite))
+                return false;
+            entry->Bits[page >> 6].fetch_or((u64)1 << (page & 63), std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+
+    static bool ArenaDirtyFault(void* address)
+    {
+        sArenaDirtyFaults.fetch_add(1);
+        const bool handled = ArenaDirtyFaultEntry(address);
+        sArenaDirtyFaults.fetch_sub(1, std::memory_order_release);
+        return handled;
+    }
+
+    arena_t* ArenaAlloc(int_t reserved_size_in_bytes, int_t commit_size_in_bytes, s8 alignment_shift, s8 page_size_shift, u32 flags)
+    {
+        const nvmem::numa_t numa = {nvmem::nnuma::Default, 0};
+        return ArenaAlloc(reserved_size_in_bytes, commit_size_in_bytes, numa, alignment_shift, page_size_shift, flags);
+    }
+
+    arena_t* ArenaAlloc(int_t reserved_size_in_bytes, int_t commit_size_in_bytes, nvmem::numa_t const& numa, s8 alignment_shift, s8 page_size_shift, u32 flags)
     {
         arena_t arena;
-        arena.Mem              = nullptr;
-        arena.Pos              = 0;
-        arena.CapacityCommited = 0;
-        arena.CapacityReserved = 0;
-        arena.PageSizeShift    = math::g_clamp<s8>(page_size_shift, sArenas.m_array.PageSizeShift, 20);
-        arena.AlignmentShift   = math::g_clamp<s8>(alignment_shift, sArenas.m_array.AlignmentShift, 16);
-
-        // align the reserved size to the page size
+        arena.Mem                  = nullptr;
+        arena.Pos                  = 0;
+        arena.CapacityCommited     = 0;
+        arena.CapacityReserved     = 0;
+        arena.PageSizeShift        = math::g_clamp<s8>(page_size_shift, sArenas.m_array.PageSizeShift, 30);
+        arena.AlignmentShift       = math::g_clamp<s8>(alignment_shift, sArenas.m_array.AlignmentShift, 16);
+        arena.PageKind             = nvmem::npage::Normal;
+        arena.Flags                = (u8)(nvmem::get_guard_mode() ? (flags | ARENA_FLAG_GUARD) : flags);
+        arena.CapacityCommitedBack = 0;
+        if ((arena.Flags & ARENA_FLAG_DOUBLE_ENDED) != 0)
+            arena.Flags &= ~ARENA_FLAG_GUARD; // the back stack ends at the end of the reservation
+
+        // align the reserved size to the page size, in guard mode one more page is reserved that is never commited
         const int_t reserved_pages   = NumBytesToPages(arena, reserved_size_in_bytes);
-        const int_t reserved_bytes   = NumPagesToBytes(arena, reserved_pages);
+        const int_t reserved_bytes   = NumPagesToBytes(arena, reserved_pages) + ArenaGuardBytes(arena);
         void*       reserved_mem_ptr = nullptr;
-        if (!nvmem::reserve((u64)reserved_bytes, nvmem::nprotect::ReadWrite, reserved_mem_ptr))
+        if (!nvmem::reserve((u64)reserved_bytes, nvmem::nprotect::ReadWrite, arena.PageSizeShift, numa, reserved_mem_ptr, arena.PageKind))
         {
             arena_error(cArenaErrorReserveMemory);
             return nullptr; // Reserve memory for the arena failed
         }
-        const int_t commit_pages = NumBytesToPages(arena, commit_size_in_bytes);
-        const int_t commit_bytes = NumPagesToBytes(arena, commit_pages);
-        if (!nvmem::commit(reserved_mem_ptr, commit_bytes))
+        nvmem::stats_t stats        = {0, 0, 0, 0};
+        const int_t    commit_pages = (arena.Flags & ARENA_FLAG_GUARD) != 0 ? 0 : math::g_min<int_t>(NumBytesToPages(arena, commit_size_in_bytes), reserved_pages);
+        const int_t    commit_bytes = NumPagesToBytes(arena, commit_pages);
+        if (commit_bytes > 0 && !ArenaCommitPages(&arena, (u8*)reserved_mem_ptr, commit_bytes, stats))
         {
             arena_error(cArenaErrorCommitMemory);
-            nvmem::release(reserved_mem_ptr, reserved_size_in_bytes); // Release the reserved memory
-            return nullptr;                                           // Commit memory for the arena failed
+            nvmem::release(reserved_mem_ptr, reserved_bytes); // Release the reserved memory
+            return nullptr;                                   // Commit memory for the arena failed
         }
 
         arena.Mem              = (u8*)reserved_mem_ptr; // Set the memory pointer to the reserved memory
         arena.CapacityReserved = reserved_pages;        // Set the reserved capacity in pages
         arena.CapacityCommited = commit_pages;          // Set the commited capacity in pages
 
-        zarena_t* zarena = nullptr;
-        if (sArenas.m_arena_free_head != nullptr)
+        zarena_t* zarena = ArenaNewSlot(arena, stats);
+        if (zarena == nullptr)
         {
-            zarena                    = sArenas.m_arena_free_head;       // Get the first arena from the free list
-            sArenas.m_arena_free_head = sArenas.m_arena_free_head->Next; // Pop the first arena from the free list
+            nvmem::release(reserved_mem_ptr, reserved_bytes); // Release the reserved memory
+            return nullptr;                                   // No more arena slots
         }
-        else if (sArenas.m_arena_free_index < sArenas.m_arena_max_index)
+        return &zarena->Arena;
+    }
+
+    static inline zarena_file_t* ArenaFileHeader(arena_t const* arena) { return (zarena_file_t*)(arena->Mem - NumPagesToBytes(*arena, 1)); }
+
+    arena_t* ArenaAllocFile(const char* path, int_t reserved_size_in_bytes, int_t commit_size_in_bytes, s8 alignment_shift, s8 page_size_shift, u32 flags)
+    {
+        arena_t arena;
+        arena.Mem                  = nullptr;
+        arena.Pos                  = 0;
+        arena.CapacityCommited     = 0;
+        arena.CapacityReserved     = 0;
+        arena.PageSizeShift        = math::g_clamp<s8>(page_size_shift, sArenas.m_array.PageSizeShift, 30);
+        arena.AlignmentShift       = math::g_clamp<s8>(alignment_shift, sArenas.m_array.AlignmentShift, 16);
+        arena.PageKind             = nvmem::npage::Normal;
+        arena.Flags                = (u8)((flags | ARENA_FLAG_FILE) & ~(ARENA_FLAG_GUARD | ARENA_FLAG_DOUBLE_ENDED));
+        arena.CapacityCommitedBack = 0;
+
+        u64                 file_size = 0;
+        const nvmem::file_t file      = path != nullptr ? nvmem::file_open(path, file_size) : nvmem::file_anonymous();
+        if (file == nvmem::cInvalidFile)
         {
-            zarena = gArenaIndexToPtr(sArenas.m_arena_free_index++); // Get the next arena from the array
+            arena_error(cArenaErrorFile);
+            return nullptr;
         }
-        else if (sArenas.m_array.CapacityCommited < sArenas.m_array.CapacityReserved)
+
+        // An existing file brings its own layout, its header is read through a mapping of the first system page
+        int_t reserved_pages = NumBytesToPages(arena, reserved_size_in_bytes);
+        int_t commit_pages   = 0;
+        void* base_hint      = nullptr;
+        if (file_size > 0)
         {
-            // Commit more memory for the arenas if we have reached the maximum index
-            // Increase capacity by 12.5%
-            const s32   addIndices  = math::g_clamp<s32>(sArenas.m_arena_max_index >> 3, 1, sArenas.m_arena_cap_index);
-            const int_t addCapacity = NumBytesToPages(sArenas.m_array, (int_t)(addIndices * sizeof(zarena_t)));
-            if (!nvmem::commit(sArenas.m_array.Mem + CommittedInBytes(sArenas.m_array), NumPagesToBytes(sArenas.m_array, addCapacity)))
+            zarena_file_t header;
+            void*         header_ptr = nullptr;
+            bool          valid      = file_size >= sizeof(zarena_file_t) && nvmem::file_map(file, nvmem::get_page_size(), nullptr, header_ptr);
+            if (valid)
             {
-                arena_error(cArenaErrorCommitMemory);
+                header = *(zarena_file_t const*)header_ptr;
+                nvmem::file_unmap(header_ptr, nvmem::get_page_size());
+
+                valid = header.Magic == cArenaFileMagic && header.Version == cArenaFileVersion;
+                valid = valid && header.PageSizeShift >= sArenas.m_array.PageSizeShift && header.PageSizeShift <= 30;
+                valid = valid && header.AlignmentShift >= 2 && header.AlignmentShift <= 16;
+            }
+            if (valid)
+            {
+                arena.PageSizeShift  = header.PageSizeShift;
+                arena.AlignmentShift = header.AlignmentShift;
+                reserved_pages       = math::g_max<int_t>(NumBytesToPages(arena, reserved_size_in_bytes), header.ReservedPages);
+                commit_pages         = math::g_min<int_t>(((int_t)file_size >> arena.PageSizeShift) - 1, reserved_pages);
+                arena.Pos            = header.Pos;
+                base_hint            = (void*)(ptr_t)(header.Base - NumPagesToBytes(arena, 1));
+                valid                = commit_pages >= 0 && header.Pos >= 0 && header.Pos <= NumPagesToBytes(arena, commit_pages);
+            }
+            if (!valid)
+            {
+                // Not an arena file or a damaged one, leave it alone
+                nvmem::file_close(file);
+                arena_error(cArenaErrorFile);
                 return nullptr;
             }
-            sArenas.m_array.CapacityCommited += addCapacity;
-            sArenas.m_arena_max_index += addIndices;
+        }
+        else
+        {
+            commit_pages = math::g_min<int_t>(NumBytesToPages(arena, commit_size_in_bytes), reserved_pages);
+        }
+
+        // The header page and the arena memory are one mapping, only the part within the file is accessible
+        const int_t header_bytes = NumPagesToBytes(arena, 1);
+        const int_t mapped_bytes = header_bytes + NumPagesToBytes(arena, reserved_pages);
+        void*       mapped_ptr   = nullptr;
+        if (!nvmem::file_resize(file, (u64)(header_bytes + NumPagesToBytes(arena, commit_pages))) || !nvmem::file_map(file, (u64)mapped_bytes, base_hint, mapped_ptr))
+        {
+            nvmem::file_close(file);
+            arena_error(cArenaErrorFile);
+            return nullptr;
         }
 
-        zarena->Name  = "none";
-        zarena->Next  = nullptr;
-        zarena->Arena = arena;
+        arena.Mem              = (u8*)mapped_ptr + header_bytes;
+        arena.CapacityReserved = (s32)reserved_pages;
+        arena.CapacityCommited = (s32)commit_pages;
+
+        zarena_file_t* header = (zarena_file_t*)mapped_ptr;
+        if (file_size == 0)
+        {
+            header->Magic          = cArenaFileMagic;
+            header->Version        = cArenaFileVersion;
+            header->Base           = (u64)(ptr_t)arena.Mem;
+            header->Pos            = 0;
+            header->PageSizeShift  = arena.PageSizeShift;
+            header->AlignmentShift = arena.AlignmentShift;
+        }
+        header->ReservedPages = (s32)reserved_pages;
+        header->Snapshot      = 0; // a snapshot does not outlive the process, the file has the state it was taken at
+        header->SnapshotPages = 0;
+
+        nvmem::stats_t stats = {0, 0, 0, 0};
+        if ((arena.Flags & ARENA_FLAG_PREFAULT) != 0 && commit_pages > 0)
+            nvmem::populate(arena.Mem, NumPagesToBytes(arena, commit_pages));
+
+        zarena_t* zarena = ArenaNewSlot(arena, stats);
+        if (zarena == nullptr)
+        {
+            nvmem::file_unmap(mapped_ptr, (u64)mapped_bytes);
+            nvmem::file_close(file);
+            return nullptr; // No more arena slots
+        }
+        zarena->File = file;
         return &zarena->Arena;
     }
 
+    bool ArenaFlush(arena_t* arena)
+    {
+        if (arena == nullptr || arena->Mem == nullptr || (arena->Flags & ARENA_FLAG_FILE) == 0)
+        {
+            arena_error(cArenaErrorNotInitialized);
+            return false;
+        }
+
+        // While a snapshot is taken the file holds the snapshot, stores to the arena don't reach it
+        zarena_file_t* header = ArenaFileHeader(arena);
+        if (header->Snapshot != 0)
+        {
+            if (!nvmem::file_sync(((zarena_t*)arena)->File))
+            {
+                arena_error(cArenaErrorFile);
+                return false;
+            }
+            return true;
+        }
+
+        // The data is stored before the header that makes it reachable, a crash in between keeps the old position
+        if (!nvmem::flush(arena->Mem, (u64)AlignToPageSize(*arena, arena->Pos)))
+        {
+            arena_error(cArenaErrorFile);
+            return false;
+        }
+        header->Pos  = arena->Pos;
+        header->Base = (u64)(ptr_t)arena->Mem;
+        if (!nvmem::flush(header, (u64)NumPagesToBytes(*arena, 1)))
+        {
+            arena_error(cArenaErrorFile);
+            return false;
+        }
+        return true;
+    }
+
+    u8* ArenaFileBase(const arena_t* arena)
+    {
+        if (arena == nullptr || arena->Mem == nullptr || (arena->Flags & ARENA_FLAG_FILE) == 0)
+            return nullptr;
+        return (u8*)(ptr_t)ArenaFileHeader(arena)->Base;
+    }
+
+    static void gArenaReleaseDone(void* user) { gArenaSlotFree((zarena_t*)user); }
+
     void ArenaRelease(arena_t* arena)
     {
         if (arena == nullptr)
             return;
 
+        if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+            ArenaDirtyUntrack(arena);
+
+        u8* const   mem           = arena->Mem;
+        const int_t commitedBytes = CommittedInBytes(*arena);
+        const int_t backBytes     = CommittedBackInBytes(*arena);
+        const int_t reservedBytes = ReservedInBytes(*arena) + ArenaGuardBytes(*arena);
+        const u8    flags         = arena->Flags;
+
+        if ((flags & ARENA_FLAG_FILE) != 0 && mem != nullptr)
+        {
+            // Record the position, the modified pages are written to the file by the OS after the unmap.
+            // With a snapshot the file keeps the snapshot and the changes since are dropped.
+            zarena_file_t* header = ArenaFileHeader(arena);
+            if (header->Snapshot == 0)
+            {
+                header->Pos  = arena->Pos;
+                header->Base = (u64)(ptr_t)mem;
+            }
+            header->Snapshot = 0;
+        }
+        const int_t headerBytes = (flags & ARENA_FLAG_FILE) != 0 ? NumPagesToBytes(*arena, 1) : 0;
+
+        arena->Mem                  = nullptr;
+        arena->CapacityReserved     = 0;
+        arena->CapacityCommited     = 0;
+        arena->CapacityCommitedBack = 0;
+        arena->PageSizeShift        = 0;
+        arena->AlignmentShift       = 0;
+        arena->PageKind             = nvmem::npage::Normal;
+        arena->Flags                = 0;
+
+        zarena_t* zarena = (zarena_t*)arena; // Cast arena to zarena_t
+        zarena->Name     = "none";           // Reset the name to "none"
+
+        if ((flags & ARENA_FLAG_FILE) != 0)
+        {
+            if (!nvmem::file_unmap(mem - headerBytes, headerBytes + reservedBytes))
+            {
+                arena_error(cArenaErrorRelease);
+            }
+            if (!nvmem::file_close(zarena->File))
+            {
+                arena_error(cArenaErrorRelease);
+            }
+            zarena->ReclaimTicket = 0;
+            gArenaSlotFree(zarena);
+            return;
+        }
+
+        if (nvmem::reclaim_running())
+        {
+            // Releasing the reservation also drops the commited pages, the slot goes on the free list when that is done
+            nvmem::release_async(mem, reservedBytes, gArenaReleaseDone, zarena);
+            return;
+        }
+
         // Release commited and reserved memory
-        if (!nvmem::decommit(arena->Mem, CommittedInBytes(*arena)))
+        if (commitedBytes > 0 && !nvmem::decommit(mem, commitedBytes))
         {
             arena_error(cArenaErrorRelease);
         }
-        if (!nvmem::release(arena->Mem, ReservedInBytes(*arena)))
+        if (backBytes > 0 && !nvmem::decommit(mem + reservedBytes - backBytes, backBytes))
+        {
+            arena_error(cArenaErrorRelease);
+        }
+        if (!nvmem::release(mem, reservedBytes))
         {
             arena_error(cArenaErrorRelease);
         }
-
-        arena->Mem              = nullptr;
-        arena->CapacityReserved = 0;
-        arena->CapacityCommited = 0;
-        arena->PageSizeShift    = 0;
-        arena->AlignmentShift   = 0;
 
         // Add to free list
-        zarena_t* zarena          = (zarena_t*)arena;          // Cast arena to zarena_t
-        zarena->Name              = "none";                    // Reset the name to "none"
-        zarena->Next              = sArenas.m_arena_free_head; // Link the arena to the head of the free list
-        sArenas.m_arena_free_head = zarena;                    // Update the head of the free list
+        gArenaSlotFree(zarena);
+    }
+
+    bool ArenaSetNuma(arena_t* arena, nvmem::numa_t const& numa)
+    {
+        if (arena == nullptr || arena->Mem == nullptr)
+        {
+            arena_error(cArenaErrorNotInitialized);
+            return false;
+        }
+        return nvmem::numa_apply(arena->Mem, ReservedInBytes(*arena), numa);
     }
 
     int_t ArenaPos(const arena_t* arena)
@@ -307,6 +812,106 @@ namespace ncore
         return arena->Pos;
     }
 
+    static inline s32 ArenaGrowTarget(zarena_t const* zarena, s32 neededPages, s32 commitedPages, s32 limitPages)
+    {
+        // In guard mode pages past the position are not accessible, so nothing is commited ahead
+        if ((zarena->Arena.Flags & ARENA_FLAG_GUARD) != 0)
+            return neededPages;
+
+        // Grow at least by the minimum commit chunk and by a percentage of what is commited (geometric growth)
+        const s32 minGrow   = math::g_max<s32>(zarena->MinCommitPages, (s32)(((s64)commitedPages * zarena->GrowthPercent) / 100));
+        const s32 newTarget = math::g_max<s32>(neededPages, commitedPages + minGrow);
+        return math::g_min<s32>(newTarget, limitPages);
+    }
+
+    // Set the size of the file of a file-backed arena to the header page plus `pages`, counted as a commit or decommit.
+    // While a snapshot is taken the file holds the snapshot and does not shrink below it.
+    static bool ArenaResizeFile(arena_t* arena, s32 pages)
+    {
+        zarena_t*            zarena     = (zarena_t*)arena;
+        zarena_file_t const* header     = ArenaFileHeader(arena);
+        const s32            file_pages = header->Snapshot != 0 ? math::g_max<s32>(pages, header->SnapshotPages) : pages;
+        const u64            t0         = nvmem::query_time_ns();
+        const bool           ok         = nvmem::file_resize(zarena->File, (u64)NumPagesToBytes(*arena, 1 + (int_t)file_pages));
+        const u64 t1     = nvmem::query_time_ns();
+        if (pages > arena->CapacityCommited)
+        {
+            zarena->Stats.commit_count += 1;
+            zarena->Stats.commit_time_ns += t1 - t0;
+        }
+        else
+        {
+            zarena->Stats.decommit_count += 1;
+            zarena->Stats.decommit_time_ns += t1 - t0;
+        }
+        return ok;
+    }
+
+    // Make the pages from `currentPages` up to `newPages` usable, a file-backed arena grows its file instead of committing.
+    static bool ArenaGrowPages(arena_t* arena, s32 currentPages, s32 newPages)
+    {
+        const int_t currentBytes = NumPagesToBytes(*arena, currentPages);
+        const int_t newBytes     = NumPagesToBytes(*arena, newPages);
+        zarena_t*   zarena       = (zarena_t*)arena;
+        if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+            ArenaDirtyMark(arena, currentPages, newPages, true); // the new pages are writable
+
+        if ((arena->Flags & ARENA_FLAG_FILE) != 0)
+        {
+            if (!ArenaResizeFile(arena, newPages))
+                return false;
+            return (arena->Flags & ARENA_FLAG_PREFAULT) == 0 || nvmem::populate(arena->Mem + currentBytes, newBytes - currentBytes);
+        }
+
+        // pages that are still being decommited in the background must not be commited again before that is done
+        if ((arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0 && zarena->ReclaimTicket != 0)
+        {
+            nvmem::reclaim_wait(zarena->ReclaimTicket);
+            zarena->ReclaimTicket = 0;
+        }
+        return ArenaCommitPages(arena, arena->Mem + currentBytes, newBytes - currentBytes, zarena->Stats);
+    }
+
+    // Double-ended arena: the back stack commits the `CapacityCommitedBack` pages at the end of the reservation. Growing
+    // takes over the pages that the front stack has commited but doesn't use, the caller checks BackLimitInPages.
+    static bool ArenaSetCapacityBack(arena_t* arena, s32 newPages)
+    {
+        zarena_t*   zarena       = (zarena_t*)arena;
+        u8* const   end          = arena->Mem + ReservedInBytes(*arena);
+        const int_t currentBytes = CommittedBackInBytes(*arena);
+        const int_t newBytes     = NumPagesToBytes(*arena, newPages);
+        if (newPages > arena->CapacityCommitedBack)
+        {
+            const s32 frontPages = arena->CapacityReserved - newPages;
+            if (arena->CapacityCommited > frontPages)
+            {
+                // double-ended arenas don't use the reclaimer, the pages are decommited right away
+                if (!nvmem::decommit(arena->Mem + NumPagesToBytes(*arena, frontPages), NumPagesToBytes(*arena, arena->CapacityCommited - frontPages), zarena->Stats))
+                {
+                    arena_error(cArenaErrorShrink);
+                    return false;
+                }
+                arena->CapacityCommited = frontPages;
+            }
+            if (!ArenaCommitPages(arena, end - newBytes, newBytes - currentBytes, zarena->Stats))
+            {
+                arena_error(cArenaErrorGrow);
+                return false;
+            }
+            zarena->PeakCommited = math::g_max<s32>(zarena->PeakCommited, arena->CapacityCommited + newPages);
+        }
+        else if (newPages < arena->CapacityCommitedBack)
+        {
+            if (!nvmem::decommit(end - currentBytes, currentBytes - newBytes, zarena->Stats))
+            {
+                arena_error(cArenaErrorShrink);
+                return false;
+            }
+        }
+        arena->CapacityCommitedBack = newPages;
+        return true;
+    }
+
     static bool ArenaSetCapacity(arena_t* arena, int_t newCapacityInBytes)
     {
         if (arena->Mem == nullptr)
@@ -318,41 +923,107 @@ namespace ncore
         s32 const newSizeInPages = NumBytesToPages(*arena, newCapacityInBytes);
         if (newSizeInPages > arena->CapacityCommited)
         {
-            if (newSizeInPages > arena->CapacityReserved)
+            if (newSizeInPages > FrontLimitInPages(*arena))
             {
                 // we cannot expand the arena beyond its reserved capacity
                 arena_error(cArenaErrorGrow);
                 return false;
             }
 
-            // if we are expanding the arena, we need to commit more memory
-            const int_t currentSizeInBytes = CommittedInBytes(*arena);
-            const int_t newSizeInBytes     = NumPagesToBytes(*arena, newSizeInPages);
+            // the front stack of a double-ended arena takes over the pages that the back stack doesn't use
+            const s32 backPages = arena->CapacityReserved - newSizeInPages;
+            if (arena->CapacityCommitedBack > backPages && !ArenaSetCapacityBack(arena, backPages))
+                return false;
 
-            if (!nvmem::commit(arena->Mem + currentSizeInBytes, newSizeInBytes - currentSizeInBytes))
+            // if we are expanding the arena, we need to commit more memory
+            zarena_t* zarena = (zarena_t*)arena;
+            if (!ArenaGrowPages(arena, arena->CapacityCommited, newSizeInPages))
             {
                 arena_error(cArenaErrorGrow);
                 return false;
             }
 
             arena->CapacityCommited = newSizeInPages;
+            zarena->PeakCommited    = math::g_max<s32>(zarena->PeakCommited, newSizeInPages);
         }
         else if (newSizeInPages < arena->CapacityCommited)
         {
             const int_t currentSizeInBytes = CommittedInBytes(*arena);
             const int_t newSizeInBytes     = NumPagesToBytes(*arena, newSizeInPages);
-            if (!nvmem::decommit(arena->Mem + newSizeInBytes, currentSizeInBytes - newSizeInBytes))
+
+            zarena_t* zarena = (zarena_t*)arena;
+            if ((arena->Flags & ARENA_FLAG_FILE) != 0)
+            {
+                if (!ArenaResizeFile(arena, newSizeInPages))
+                {
+                    arena_error(cArenaErrorShrink);
+                    return false;
+                }
+            }
+            else if (nvmem::reclaim_running() && (arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
+            {
+                zarena->ReclaimTicket = nvmem::decommit_async(arena->Mem + newSizeInBytes, currentSizeInBytes - newSizeInBytes, zarena->Stats);
+            }
+            else if (!nvmem::decommit(arena->Mem + newSizeInBytes, currentSizeInBytes - newSizeInBytes, zarena->Stats))
             {
                 arena_error(cArenaErrorShrink);
                 return false;
             }
 
+            if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+                ArenaDirtyMark(arena, newSizeInPages, arena->CapacityCommited, false);
             arena->CapacityCommited = newSizeInPages;
         }
 
         return true;
     }
 
+    // Push of an arena with ARENA_FLAG_GUARD, which only has the pages in use commited. A push of a page or more is moved
+    // up to end against a NoAccess page, the position continues after that page.
+    static void* ArenaPushGuarded(arena_t* arena, int_t size_bytes, s32 alignment)
+    {
+        const int_t pageSize    = NumPagesToBytes(*arena, 1);
+        int_t       start       = math::g_alignUp<int_t>(arena->Pos, alignment);
+        int_t       end         = start + size_bytes;
+        s32         neededPages = (s32)NumBytesToPages(*arena, end);
+        bool        guarded     = size_bytes >= pageSize;
+        if (guarded)
+        {
+            // the block is moved down from the guard page, aligned to at least the minimum alignment of the arena, it
+            // never moves below the aligned position so it can't overlap the previous pushes
+            const int_t blockAlignment = math::g_max<int_t>(alignment, (int_t)1 << arena->AlignmentShift);
+            const int_t alignedPos     = math::g_alignUp<int_t>(arena->Pos, blockAlignment);
+            const int_t guardPos       = AlignToPageSize(*arena, alignedPos + size_bytes);
+            start                      = (guardPos - size_bytes) & ~(blockAlignment - 1);
+            end                        = guardPos + pageSize;
+            neededPages                = (s32)(end >> arena->PageSizeShift);
+            if (neededPages == arena->CapacityReserved + 1)
+            {
+                // the page after the reservation is the guard page
+                end         = guardPos;
+                neededPages = arena->CapacityReserved;
+                guarded     = false;
+            }
+        }
+        if (neededPages > arena->CapacityReserved)
+        {
+            arena_error(cArenaErrorGrow);
+            return nullptr; // We cannot expand the arena beyond its reserved capacity
+        }
+        if (neededPages > arena->CapacityCommited && !ArenaSetCapacity(arena, NumPagesToBytes(*arena, neededPages)))
+        {
+            return nullptr; // Failed to grow the arena
+        }
+        if (guarded && !nvmem::protect(arena->Mem + end - pageSize, pageSize, nvmem::nprotect::NoAccess))
+        {
+            arena_error(cArenaErrorGrow);
+            return nullptr;
+        }
+
+        arena->Pos = end;
+        return arena->Mem + start;
+    }
+
     void* ArenaPush(arena_t* arena, int_t size_bytes)
     {
         if (size_bytes <= 0)
@@ -363,11 +1034,22 @@ namespace ncore
 
         if ((arena->Pos + size_bytes) > CommittedInBytes(*arena))
         {
-            // Calculate the new capacity in bytes, aligned to page size
-            // We add a page size to ensure we have enough space for the allocation
-            const int_t newCapacity        = NumBytesToPages(*arena, arena->Pos + size_bytes);
-            const int_t newCapacityInBytes = NumPagesToBytes(*arena, newCapacity);
-            if (!ArenaSetCapacity(arena, newCapacityInBytes))
+            // In guard mode the commited range ends at the page of the position, any push that needs a new page ends up here
+            if ((arena->Flags & ARENA_FLAG_GUARD) != 0)
+                return ArenaPushGuarded(arena, size_bytes, 1);
+
+            // Calculate the new capacity in pages, grown according to the policy of the arena
+            const s32 neededPages = (s32)NumBytesToPages(*arena, arena->Pos + size_bytes);
+            const s32 limitPages  = FrontLimitInPages(*arena);
+            if (neededPages > limitPages)
+            {
+                // running into the back stack of a double-ended arena is not an error
+                if ((arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
+                    arena_error(cArenaErrorGrow);
+                return nullptr; // We cannot expand the arena beyond its reserved capacity
+            }
+            const s32 newCapacity = ArenaGrowTarget((zarena_t*)arena, neededPages, arena->CapacityCommited, limitPages);
+            if (!ArenaSetCapacity(arena, NumPagesToBytes(*arena, newCapacity)))
             {
                 return nullptr; // Failed to grow the arena
             }
@@ -378,6 +1060,82 @@ namespace ncore
         return (arena->Mem + pos); // Return the pointer to the allocated memory
     }
 
+    // Wait until the commited range covers `end_pos`, one thread commits while the others spin on the commited watermark.
+    static bool ArenaEnsureCommitedConcurrent(arena_t* arena, int_t end_pos)
+    {
+        const s32 needed_pages = (s32)NumBytesToPages(*arena, end_pos);
+        if (needed_pages > arena->CapacityReserved)
+        {
+            arena_error(cArenaErrorGrow);
+            return false;
+        }
+
+        std::atomic<s32>& lock  = ((zarena_t*)arena)->GrowLock;
+        s32               spins = 0;
+        while (AtomicLoadCommited(arena) < needed_pages)
+        {
+            s32 unlocked = 0;
+            if (lock.load(std::memory_order_relaxed) == 0 && lock.compare_exchange_strong(unlocked, 1, std::memory_order_acquire))
+            {
+                const s32 current_pages = AtomicLoadCommited(arena);
+                bool      ok            = true;
+                if (current_pages < needed_pages)
+                {
+                    const s32 target_pages = ArenaGrowTarget((zarena_t*)arena, needed_pages, current_pages, arena->CapacityReserved);
+                    zarena_t* zarena       = (zarena_t*)arena;
+                    ok                     = ArenaGrowPages(arena, current_pages, target_pages);
+                    if (ok)
+                    {
+                        zarena->PeakCommited = math::g_max<s32>(zarena->PeakCommited, target_pages);
+                        AtomicStoreCommited(arena, target_pages);
+                    }
+                }
+                lock.store(0, std::memory_order_release);
+                if (!ok)
+                {
+                    arena_error(cArenaErrorGrow);
+                    return false;
+                }
+            }
+            else if (++spins > 64)
+            {
+                std::this_thread::yield();
+                spins = 0;
+            }
+        }
+        return true;
+    }
+
+    void* ArenaPushConcurrent(arena_t* arena, int_t size_bytes)
+    {
+        if (size_bytes <= 0)
+        {
+            arena_error(cArenaErrorGrow);
+            return nullptr; // Invalid size request
+        }
+
+        // Round up the size so that every concurrent push stays at the minimum alignment of the arena
+        size_bytes      = math::g_alignUp<int_t>(size_bytes, (int_t)1 << arena->AlignmentShift);
+        const int_t pos = AtomicAddPos(arena, size_bytes);
+        if (!ArenaEnsureCommitedConcurrent(arena, pos + size_bytes))
+            return nullptr; // Failed to grow the arena
+
+        return (arena->Mem + pos);
+    }
+
+    void* ArenaPushConcurrentAligned(arena_t* arena, int_t size_bytes, s32 alignment)
+    {
+        const int_t min_alignment = (int_t)1 << arena->AlignmentShift;
+        if (alignment <= min_alignment)
+            return ArenaPushConcurrent(arena, size_bytes);
+
+        // Over-allocate so that an aligned block of `size_bytes` always fits
+        u8* ptr = (u8*)ArenaPushConcurrent(arena, size_bytes + alignment - min_alignment);
+        if (ptr == nullptr)
+            return nullptr;
+        return (void*)math::g_alignUp<ptr_t>((ptr_t)ptr, (ptr_t)alignment);
+    }
+
     void* ArenaPushZero(arena_t* arena, int_t size_bytes)
     {
         void* ptr = ArenaPush(arena, size_bytes);
@@ -390,16 +1148,14 @@ namespace ncore
 
     void* ArenaPushAligned(arena_t* arena, int_t size_bytes, s32 alignment)
     {
+        if ((arena->Flags & ARENA_FLAG_GUARD) != 0)
+            return ArenaPushGuarded(arena, size_bytes, alignment);
+
+        // Push the alignment padding together with the block, the returned block starts at the aligned position
         const int_t alignedPos = math::g_alignUp<int_t>(arena->Pos, alignment);
-        if ((alignedPos + size_bytes) > CommittedInBytes(*arena))
-        {
-            if (!ArenaSetCapacity(arena, alignedPos + size_bytes))
-            {
-                arena_error(cArenaErrorGrow);
-                return nullptr; // Failed to grow the arena
-            }
-        }
-        return ArenaPush(arena, size_bytes);
+        if (ArenaPush(arena, (alignedPos - arena->Pos) + size_bytes) == nullptr)
+            return nullptr; // Failed to grow the arena
+        return arena->Mem + alignedPos;
     }
 
     void* ArenaPushZeroAligned(arena_t* arena, int_t size_bytes, s32 alignment)
@@ -412,36 +1168,358 @@ namespace ncore
         return ptr;
     }
 
+    // Telemetry is kept off the push path, the peak position and the popped bytes are only updated when the position goes down.
+    static inline void ArenaTrackPop(arena_t* arena, int_t position)
+    {
+        zarena_t* zarena = (zarena_t*)arena;
+        zarena->PeakPos  = math::g_max<int_t>(zarena->PeakPos, arena->Pos);
+        zarena->PoppedBytes += arena->Pos - position;
+    }
+
+    // Guard mode: decommit the pages above the position, stale pointers into popped memory fault when they are used.
+    static void ArenaGuardPop(arena_t* arena)
+    {
+        const s32 usedPages = (s32)NumBytesToPages(*arena, arena->Pos);
+        if (usedPages >= arena->CapacityCommited || !ArenaSetCapacity(arena, NumPagesToBytes(*arena, usedPages)))
+            return;
+
+        // the position can land on the guard page of a large push, pushing from there must not fault
+        if ((arena->Pos & (NumPagesToBytes(*arena, 1) - 1)) != 0)
+            nvmem::protect(arena->Mem + NumPagesToBytes(*arena, usedPages - 1), NumPagesToBytes(*arena, 1), nvmem::nprotect::ReadWrite);
+    }
+
     void ArenaPopTo(arena_t* arena, int_t position)
     {
-        position   = math::g_clamp<int_t>(position, 0, arena->Pos); // Ensure position is within valid range
+        position = math::g_clamp<int_t>(position, 0, arena->Pos); // Ensure position is within valid range
+        ArenaTrackPop(arena, position);
         arena->Pos = position;
+        if ((arena->Flags & ARENA_FLAG_GUARD) != 0)
+            ArenaGuardPop(arena);
     }
 
     void ArenaPop(arena_t* arena, int_t size_bytes)
     {
         size_bytes = math::g_clamp<int_t>(size_bytes, 0, arena->Pos); // Ensure size_bytes is within valid range
+        ArenaTrackPop(arena, arena->Pos - size_bytes);
         arena->Pos -= size_bytes;
+        if ((arena->Flags & ARENA_FLAG_GUARD) != 0)
+            ArenaGuardPop(arena);
     }
 
-    void ArenaClear(arena_t* arena, int_t keep_commited_bytes)
+    int_t ArenaPosBack(const arena_t* arena)
     {
-        const int_t keep_commited_pages = math::g_clamp<int_t>(NumBytesToPages(*arena, keep_commited_bytes), 0, arena->CapacityCommited);
+        if (arena == nullptr || (arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
+            return -1; // Invalid arena pointer or not a double-ended arena
+        return ((zarena_t const*)arena)->PosBack;
+    }
 
-        arena->Pos = 0;
-        if (keep_commited_pages < arena->CapacityCommited)
+    void* ArenaPushBack(arena_t* arena, int_t size_bytes)
+    {
+        if (size_bytes <= 0 || (arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
         {
-            const int_t currentSizeInBytes = CommittedInBytes(*arena);
-            const int_t newSizeInBytes     = NumPagesToBytes(*arena, keep_commited_pages);
-            if (newSizeInBytes < currentSizeInBytes)
+            arena_error(cArenaErrorGrow);
+            return nullptr; // Invalid size request or not a double-ended arena
+        }
+
+        zarena_t*   zarena  = (zarena_t*)arena;
+        const int_t posBack = zarena->PosBack + math::g_alignUp<int_t>(size_bytes, (int_t)1 << arena->AlignmentShift);
+        if (posBack > CommittedBackInBytes(*arena))
+        {
+            // The back stack can grow down to the pages in use by the front stack, meeting it is not an error
+            const s32 neededPages = (s32)NumBytesToPages(*arena, posBack);
+            const s32 limitPages  = BackLimitInPages(*arena);
+            if (neededPages > limitPages)
+                return nullptr;
+            const s32 newCapacity = ArenaGrowTarget(zarena, neededPages, arena->CapacityCommitedBack, limitPages);
+            if (!ArenaSetCapacityBack(arena, newCapacity))
+                return nullptr; // Failed to grow the back stack
+        }
+
+        zarena->PosBack = posBack;
+        return arena->Mem + ReservedInBytes(*arena) - posBack;
+    }
+
+    void ArenaPopBackTo(arena_t* arena, int_t position)
+    {
+        if ((arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
+            return;
+        zarena_t* zarena = (zarena_t*)arena;
+        zarena->PosBack  = math::g_clamp<int_t>(position, 0, zarena->PosBack); // Ensure position is within valid range
+    }
+
+    void ArenaClearBack(arena_t* arena, int_t keep_commited_bytes)
+    {
+        if ((arena->Flags & ARENA_FLAG_DOUBLE_ENDED) == 0)
+            return;
+        zarena_t* zarena    = (zarena_t*)arena;
+        const s32 keepPages = math::g_max<s32>((s32)NumBytesToPages(*arena, keep_commited_bytes), zarena->KeepPages);
+        zarena->PosBack     = 0;
+        if (keepPages < arena->CapacityCommitedBack)
+            ArenaSetCapacityBack(arena, keepPages);
+    }
+
+    // Store the pages that were copied since the snapshot into the file, the file then holds the current state.
+    static bool ArenaSnapshotWriteback(arena_t* arena)
+    {
+        zarena_t* zarena = (zarena_t*)arena;
+        if (!nvmem::file_writeback(zarena->File, (u64)NumPagesToBytes(*arena, 1), arena->Mem, (u64)CommittedInBytes(*arena)))
+        {
+            arena_error(cArenaErrorFile);
+            return false;
+        }
+        return true;
+    }
+
+    bool ArenaSnapshot(arena_t* arena)
+    {
+        if (arena == nullptr || arena->Mem == nullptr || (arena->Flags & ARENA_FLAG_FILE) == 0)
+        {
+            arena_error(cArenaErrorSnapshot);
+            return false;
+        }
+
+        // The changes since a previous snapshot are kept
+        zarena_file_t* header = ArenaFileHeader(arena);
+        if (header->Snapshot != 0 && !ArenaSnapshotWriteback(arena))
+            return false;
+
+        // From here on a store copies the page, the file keeps the content of the snapshot
+        zarena_t* zarena = (zarena_t*)arena;
+        if (!nvmem::file_remap(zarena->File, (u64)NumPagesToBytes(*arena, 1), arena->Mem, (u64)ReservedInBytes(*arena), true))
+        {
+            arena_error(cArenaErrorFile);
+            return false;
+        }
+        header->Pos           = arena->Pos;
+        header->Base          = (u64)(ptr_t)arena->Mem;
+        header->SnapshotPages = arena->CapacityCommited;
+        header->Snapshot      = 1;
+        if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+            ArenaDirtyProtectClean(arena); // the new mapping is writable
+        return true;
+    }
+
+    bool ArenaRestore(arena_t* arena)
+    {
+        if (arena == nullptr || arena->Mem == nullptr || (arena->Flags & ARENA_FLAG_FILE) == 0 || ArenaFileHeader(arena)->Snapshot == 0)
+        {
+            arena_error(cArenaErrorSnapshot);
+            return false;
+        }
+
+        // Mapping the file again drops the copied pages, the file is cut back to the size it had at the snapshot
+        zarena_t*            zarena = (zarena_t*)arena;
+        zarena_file_t const* header = ArenaFileHeader(arena);
+        if (!nvmem::file_remap(zarena->File, (u64)NumPagesToBytes(*arena, 1), arena->Mem, (u64)ReservedInBytes(*arena), true) || !ArenaResizeFile(arena, header->SnapshotPages))
+        {
+            arena_error(cArenaErrorFile);
+            return false;
+        }
+        if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+        {
+            // the content goes back to the snapshot, every page may have changed
+            ArenaDirtyMark(arena, header->SnapshotPages, arena->CapacityCommited, false);
+            ArenaDirtyMark(arena, 0, header->SnapshotPages, true);
+        }
+        arena->CapacityCommited = header->SnapshotPages;
+
+        if (header->Pos < arena->Pos)
+            ArenaTrackPop(arena, header->Pos);
+        else
+            zarena->PoppedBytes -= header->Pos - arena->Pos; // bytes that were popped since the snapshot are back
+        arena->Pos = header->Pos;
+        return true;
+    }
+
+    bool ArenaSnapshotDrop(arena_t* arena)
+    {
+        if (arena == nullptr || arena->Mem == nullptr || (arena->Flags & ARENA_FLAG_FILE) == 0 || ArenaFileHeader(arena)->Snapshot == 0)
+        {
+            arena_error(cArenaErrorSnapshot);
+            return false;
+        }
+
+        zarena_t*      zarena = (zarena_t*)arena;
+        zarena_file_t* header = ArenaFileHeader(arena);
+        if (!ArenaSnapshotWriteback(arena))
+            return false;
+        if (!nvmem::file_remap(zarena->File, (u64)NumPagesToBytes(*arena, 1), arena->Mem, (u64)ReservedInBytes(*arena), false))
+        {
+            arena_error(cArenaErrorFile);
+            return false;
+        }
+        header->Snapshot = 0;
+        if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+            ArenaDirtyProtectClean(arena); // the new mapping is writable
+        return ArenaResizeFile(arena, arena->CapacityCommited);
+    }
+
+    bool ArenaDirtyTrack(arena_t* arena)
+    {
+        if (arena == nullptr || arena->Mem == nullptr || (arena->Flags & (ARENA_FLAG_GUARD | ARENA_FLAG_DOUBLE_ENDED)) != 0)
+        {
+            arena_error(cArenaErrorDirty);
+            return false;
+        }
+        if ((arena->Flags & ARENA_FLAG_DIRTY) != 0)
+            return true;
+
+        const u64 pageSize  = nvmem::get_page_size();
+        const u64 bitsRange = math::g_alignUp<u64>((u64)((arena->CapacityReserved + 63) >> 6) * sizeof(u64), pageSize);
+        void*     bits      = nullptr;
+        if (!nvmem::set_write_fault_handler(ArenaDirtyFault) || !nvmem::reserve(bitsRange, nvmem::nprotect::ReadWrite, bits))
+        {
+            arena_error(cArenaErrorDirty);
+            return false;
+        }
+        if (!nvmem::commit(bits, bitsRange))
+        {
+            nvmem::release(bits, bitsRange);
+            arena_error(cArenaErrorDirty);
+            return false;
+        }
+
+        std::atomic<u64>* words = (std::atomic<u64>*)bits;
+        for (u64 i = 0; i < bitsRange / sizeof(u64); ++i)
+            new (&words[i]) std::atomic<u64>(0);
+
+        zarena_dirty_t* entry = nullptr;
+        ArenaDirtyLock();
+        for (s32 i = 0; i < ARENA_DIRTY_MAX && entry == nullptr; ++i)
+        {
+            if (sArenaDirty[i].Arena.load(std::memory_order_relaxed) == nullptr)
+            {
+                entry            = &sArenaDirty[i];
+                entry->Bits      = words;
+                entry->BitsRange = bitsRange;
+                entry->Arena.store(arena, std::memory_order_release);
+            }
+        }
+        ArenaDirtyUnlock();
+        if (entry == nullptr)
+        {
+            nvmem::release(bits, bitsRange);
+            arena_error(cArenaErrorDirty);
+            return false; // all entries are in use
+        }
+
+        // Everything that is commited is dirty until the first checkpoint
+        ArenaDirtyMark(arena, 0, arena->CapacityCommited, true);
+        arena->Flags |= ARENA_FLAG_DIRTY;
+        return true;
+    }
+
+    // Write-protect the pages [firstPage, endPage) that were just made clean and hand them to `fn`, a store from here on
+    // marks a page dirty again. @returns the size of the run in bytes.
+    static int_t ArenaDirtyRun(arena_t* arena, s32 firstPage, s32 endPage, arena_dirty_fn fn, void* user)
+    {
+        const int_t offset = NumPagesToBytes(*arena, firstPage);
+        const int_t size   = NumPagesToBytes(*arena, endPage - firstPage);
+        nvmem::protect(arena->Mem + offset, size, nvmem::nprotect::Read);
+        if (fn != nullptr)
+            fn(arena, offset, size, user);
+        return size;
+    }
+
+    int_t ArenaDirtyCheckpoint(arena_t* arena, arena_dirty_fn fn, void* user)
+    {
+        zarena_dirty_t* entry = arena != nullptr ? ArenaDirtyEntry(arena) : nullptr;
+        if (entry == nullptr)
+        {
+            arena_error(cArenaErrorDirty);
+            return 0;
+        }
+
+        // Take the dirty bits a word at a time, bits of pages that are commited while this runs are left alone
+        int_t     dirtyBytes = 0;
+        s32       runBegin   = -1; // first page of the current run of dirty pages, -1 when there is none
+        const s32 pages      = arena->CapacityCommited;
+        for (s32 word = 0; (word << 6) < pages; ++word)
+        {
+            const s32 count = math::g_min<s32>(pages - (word << 6), 64);
+            const u64 mask  = count == 64 ? ~(u64)0 : (((u64)1 << count) - 1);
+            const u64 bits  = entry->Bits[word].fetch_and(~mask, std::memory_order_acq_rel) & mask;
+            if ((bits == 0 && runBegin < 0) || (bits == ~(u64)0 && runBegin >= 0))
+                continue;
+            for (s32 bit = 0; bit < 64; ++bit)
             {
-                if (!nvmem::decommit(arena->Mem + newSizeInBytes, currentSizeInBytes - newSizeInBytes))
+                const bool dirty = ((bits >> bit) & 1) != 0;
+                if (dirty && runBegin < 0)
                 {
-                    arena_error(cArenaErrorShrink);
+                    runBegin = (word << 6) + bit;
+                }
+                else if (!dirty && runBegin >= 0)
+                {
+                    dirtyBytes += ArenaDirtyRun(arena, runBegin, (word << 6) + bit, fn, user);
+                    runBegin = -1;
                 }
             }
-            arena->CapacityCommited = keep_commited_pages;
         }
+        if (runBegin >= 0)
+            dirtyBytes += ArenaDirtyRun(arena, runBegin, pages, fn, user);
+        return dirtyBytes;
+    }
+
+    void ArenaDirtyUntrack(arena_t* arena)
+    {
+        zarena_dirty_t* entry = arena != nullptr ? ArenaDirtyEntry(arena) : nullptr;
+        if (entry == nullptr)
+            return;
+
+        // Clean pages are write-protected, after this stores don't fault anymore
+        if (arena->CapacityCommited > 0)
+            nvmem::protect(arena->Mem, CommittedInBytes(*arena), nvmem::nprotect::ReadWrite);
+        arena->Flags &= ~ARENA_FLAG_DIRTY;
+
+        // A handler that loaded the entry before it was cleared is counted, wait for those to return
+        ArenaDirtyLock();
+        entry->Arena.store(nullptr);
+        while (sArenaDirtyFaults.load() != 0)
+            std::this_thread::yield();
+        nvmem::release((void*)entry->Bits, entry->BitsRange);
+        entry->Bits      = nullptr;
+        entry->BitsRange = 0;
+        ArenaDirtyUnlock();
+    }
+
+    // Shrink the commited range to `keepPages`, subject to the decommit policy of the arena.
+    // `usedPages` is the number of pages that were in use, with a decommit delay the arena only shrinks after observing
+    // a number of these calls and then never below what the peak usage of those would have grown to.
+    static void ArenaShrink(arena_t* arena, s32 keepPages, s32 usedPages)
+    {
+        if ((arena->Flags & ARENA_FLAG_GUARD) != 0)
+        {
+            ArenaGuardPop(arena);
+            return;
+        }
+
+        zarena_t* zarena = (zarena_t*)arena;
+        keepPages        = math::g_max<s32>(keepPages, zarena->KeepPages);
+        if (zarena->DecommitDelay > 0)
+        {
+            zarena->PeakPages = math::g_max<s32>(zarena->PeakPages, usedPages);
+            if (++zarena->ClearCount < zarena->DecommitDelay)
+                return;
+            if (zarena->PeakPages > 0)
+                keepPages = math::g_max<s32>(keepPages, ArenaGrowTarget(zarena, zarena->PeakPages, zarena->PeakPages - 1, FrontLimitInPages(*arena)));
+            zarena->ClearCount = 0;
+            zarena->PeakPages  = 0;
+        }
+
+        if (keepPages < arena->CapacityCommited)
+        {
+            ArenaSetCapacity(arena, NumPagesToBytes(*arena, keepPages));
+        }
+    }
+
+    void ArenaClear(arena_t* arena, int_t keep_commited_bytes)
+    {
+        const s32 keep_commited_pages = (s32)math::g_clamp<int_t>(NumBytesToPages(*arena, keep_commited_bytes), 0, arena->CapacityCommited);
+        const s32 used_pages          = (s32)NumBytesToPages(*arena, arena->Pos);
+
+        ArenaTrackPop(arena, 0);
+        arena->Pos = 0;
+        ArenaShrink(arena, keep_commited_pages, used_pages);
     }
 
     void ArenaCommit(arena_t* arena, int_t set_commited_bytes)
@@ -449,7 +1527,97 @@ namespace ncore
         if (arena == nullptr)
             return;
 
-        ArenaSetCapacity(arena, set_commited_bytes);
+        const s32 pages = (s32)NumBytesToPages(*arena, set_commited_bytes);
+        if (pages >= arena->CapacityCommited)
+        {
+            // in guard mode pages are only commited when a push needs them
+            if ((arena->Flags & ARENA_FLAG_GUARD) == 0)
+                ArenaSetCapacity(arena, set_commited_bytes);
+        }
+        else
+        {
+            ArenaShrink(arena, pages, (s32)NumBytesToPages(*arena, arena->Pos));
+        }
+    }
+
+    void ArenaSetPolicy(arena_t* arena, arena_policy_t const& policy)
+    {
+        zarena_t* zarena       = (zarena_t*)arena;
+        zarena->MinCommitPages = (s32)math::g_clamp<int_t>(NumBytesToPages(*arena, policy.MinCommitBytes), 0, arena->CapacityReserved);
+        zarena->GrowthPercent  = math::g_max<s32>(policy.GrowthPercent, 0);
+        zarena->KeepPages      = (s32)math::g_clamp<int_t>(NumBytesToPages(*arena, policy.KeepCommitBytes), 0, arena->CapacityReserved);
+        zarena->DecommitDelay  = (s16)math::g_clamp<s32>(policy.DecommitDelay, 0, 0x7fff);
+        zarena->ClearCount     = 0;
+        zarena->PeakPages      = 0;
+    }
+
+    void ArenaGetPolicy(const arena_t* arena, arena_policy_t& policy)
+    {
+        zarena_t const* zarena = (zarena_t const*)arena;
+        policy.MinCommitBytes  = NumPagesToBytes(*arena, zarena->MinCommitPages);
+        policy.GrowthPercent   = zarena->GrowthPercent;
+        policy.KeepCommitBytes = NumPagesToBytes(*arena, zarena->KeepPages);
+        policy.DecommitDelay   = zarena->DecommitDelay;
+    }
+
+    void ArenaGetStats(const arena_t* arena, arena_stats_t& stats)
+    {
+        zarena_t const* zarena  = (zarena_t const*)arena;
+        const int_t     pos     = arena->Pos;
+        stats.Name              = zarena->Name;
+        stats.ReservedBytes     = ReservedInBytes(*arena);
+        stats.CommitedBytes     = CommittedInBytes(*arena) + CommittedBackInBytes(*arena);
+        stats.Pos               = pos;
+        stats.BytesPushed       = zarena->PoppedBytes + pos;
+        stats.PeakPos           = math::g_max<int_t>(zarena->PeakPos, pos);
+        stats.PeakCommitedBytes = NumPagesToBytes(*arena, zarena->PeakCommited);
+        stats.CommitCount       = zarena->Stats.commit_count;
+        stats.CommitTimeNs      = zarena->Stats.commit_time_ns;
+        stats.DecommitCount     = zarena->Stats.decommit_count;
+        stats.DecommitTimeNs    = zarena->Stats.decommit_time_ns;
+    }
+
+    void ArenasForEach(arena_stats_fn fn, void* user)
+    {
+        if (sArenas.m_array.Mem == nullptr)
+            return;
+
+        // Slots that were never used are not commited, a released slot has no memory
+        const s32 count = math::g_min<s32>(sArenas.m_arena_free_index.load(std::memory_order_acquire), sArenas.m_arena_max_index.load(std::memory_order_acquire));
+        for (s32 i = 0; i < count; ++i)
+        {
+            zarena_t* zarena = gArenaIndexToPtr(i);
+            if (zarena->Arena.Mem == nullptr)
+                continue;
+            arena_stats_t stats;
+            ArenaGetStats(&zarena->Arena, stats);
+            fn(&zarena->Arena, stats, user);
+        }
+    }
+
+    struct zarena_snapshot_t
+    {
+        arena_stats_t* Stats;
+        s32            MaxCount;
+        s32            Count;
+    };
+
+    static void gArenaSnapshotFn(const arena_t*, arena_stats_t const& stats, void* user)
+    {
+        zarena_snapshot_t* snapshot = (zarena_snapshot_t*)user;
+        if (snapshot->Count < snapshot->MaxCount)
+            snapshot->Stats[snapshot->Count] = stats;
+        snapshot->Count += 1;
+    }
+
+    s32 ArenasSnapshot(arena_stats_t* stats, s32 max_count)
+    {
+        zarena_snapshot_t snapshot;
+        snapshot.Stats    = stats;
+        snapshot.MaxCount = max_count;
+        snapshot.Count    = 0;
+        ArenasForEach(gArenaSnapshotFn, &snapshot);
+        return snapshot.Count;
     }
 
     bool ArenaIsValid(const arena_t* arena)
@@ -458,7 +1626,11 @@ namespace ncore
             return false;
 
         // Check if the arena has a valid memory pointer and capacity
-        if (arena->Mem == nullptr || arena->CapacityReserved <= 0 || arena->CapacityCommited <= 0)
+        if (arena->Mem == nullptr || arena->CapacityReserved <= 0 || arena->CapacityCommited < 0)
+            return false;
+
+        // Only a guard arena, which commits the pages in use, has nothing commited when it is empty
+        if (arena->CapacityCommited == 0 && (arena->Flags & ARENA_FLAG_GUARD) == 0)
             return false;
 
         // Check if the position is within the commited range
@@ -467,4 +1639,89 @@ namespace ncore
 
         return true;
     }
+
+    // ------------------------------------------------------------------------------------------------------------------
+    // Scratch arenas
+
+    static int_t sScratchReservedBytes = 64 * 1024 * 1024;
+    static int_t sScratchCommitBytes   = 64 * 1024;
+
+    struct zscratch_t
+    {
+        arena_t* Arenas[ARENA_SCRATCH_COUNT];
+        s32      Generation; // value of sArenasGeneration when the arenas were created
+
+        ~zscratch_t() { ScratchRelease(); }
+    };
+
+    static thread_local zscratch_t sScratch;
+
+    void ScratchSetup(int_t reserved_size_in_bytes, int_t commit_size_in_bytes)
+    {
+        sScratchReservedBytes = reserved_size_in_bytes;
+        sScratchCommitBytes   = math::g_min<int_t>(commit_size_in_bytes, reserved_size_in_bytes);
+    }
+
+    scratch_t ScratchBegin(arena_t* const* conflicts, s32 num_conflicts)
+    {
+        zscratch_t& scratch = sScratch;
+        if (scratch.Generation != sArenasGeneration)
+        {
+            // arenas of an earlier setup, their slots and memory are gone
+            for (s32 i = 0; i < ARENA_SCRATCH_COUNT; ++i)
+                scratch.Arenas[i] = nullptr;
+            scratch.Generation = sArenasGeneration;
+        }
+
+        scratch_t result;
+        result.Arena = nullptr;
+        result.Pos   = 0;
+        for (s32 i = 0; i < ARENA_SCRATCH_COUNT; ++i)
+        {
+            arena_t* arena    = scratch.Arenas[i];
+            bool     conflict = false;
+            for (s32 j = 0; j < num_conflicts && arena != nullptr; ++j)
+                conflict = conflict || (conflicts[j] == arena);
+            if (conflict)
+                continue;
+
+            if (arena == nullptr)
+            {
+                arena = ArenaAlloc(sScratchReservedBytes, sScratchCommitBytes);
+                if (arena == nullptr)
+                {
+                    ASSERTS(false, "failed to allocate a scratch arena");
+                    return result;
+                }
+                ArenaSetName(arena, "scratch");
+                scratch.Arenas[i] = arena;
+            }
+
+            result.Arena = arena;
+            result.Pos   = ArenaPos(arena);
+            return result;
+        }
+
+        ASSERTS(false, "no scratch arena available, all of them conflict");
+        return result;
+    }
+
+    scratch_t ScratchBegin(arena_t* conflict) { return ScratchBegin(&conflict, 1); }
+
+    void ScratchEnd(scratch_t scratch)
+    {
+        if (scratch.Arena != nullptr)
+            ArenaPopTo(scratch.Arena, scratch.Pos);
+    }
+
+    void ScratchRelease()
+    {
+        zscratch_t& scratch = sScratch;
+        for (s32 i = 0; i < ARENA_SCRATCH_COUNT; ++i)
+        {
+            if (scratch.Arenas[i] != nullptr && scratch.Generation == sArenasGeneration && sArenas.m_array.Mem != nullptr)
+                ArenaRelease(scratch.Arenas[i]);
+            scratch.Arenas[i] = nullptr;
+        }
+    }
 } // namespace ncore
@@ -0,0 +1,487 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_heap.h"
+
+#include <mutex>
+#include <new>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        enum
+        {
+            cHeapClassCount   = 40,
+            cHeapSmallMax     = 32768, // largest size class
+            cHeapSpanShift    = 16,    // spans are 64 KiB
+            cHeapSpanSize     = 1 << cHeapSpanShift,
+            cHeapBitmapWords  = (cHeapSpanSize / 16 + 63) / 64, // enough bits for the smallest size class
+            cHeapLargeHeader  = 64,                             // header in front of a large allocation
+            cHeapMinAlignment = 16,
+        };
+
+        // 16 to 128 in steps of 16, then 4 classes between every power of two
+        static const u32 s_heap_class_size[cHeapClassCount] = {
+          16,   32,   48,   64,   80,   96,   112,  128,   160,   192,   224,   256,   320,   384,   448,   512,   640,   768,   896,   1024,
+          1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192, 10240, 12288, 14336, 16384, 20480, 24576, 28672, 32768,
+        };
+
+#if defined(_MSC_VER)
+        static inline s32 s_heap_log2(u32 v)
+        {
+            unsigned long i;
+            _BitScanReverse(&i, v);
+            return (s32)i;
+        }
+        static inline s32 s_heap_lowest_bit(u64 v)
+        {
+            unsigned long i;
+            _BitScanForward64(&i, v);
+            return (s32)i;
+        }
+#else
+        static inline s32 s_heap_log2(u32 v) { return 31 - __builtin_clz(v); }
+        static inline s32 s_heap_lowest_bit(u64 v) { return __builtin_ctzll(v); }
+#endif
+
+        static inline u32 s_heap_class_of(u32 size)
+        {
+            if (size <= 128)
+                return size == 0 ? 0 : ((size + 15) >> 4) - 1;
+            const s32 p      = s_heap_log2(size - 1); // (1 << p) < size <= (1 << (p + 1))
+            const s32 step   = p - 2;
+            const u32 within = (size - (1u << p) + (1u << step) - 1) >> step;
+            return 8 + (u32)(p - 7) * 4 + within - 1;
+        }
+
+        // Metadata of a span, lives outside of the span so that a span that is decommited costs nothing.
+        struct heap_span_t
+        {
+            u32 Next;  // partial list or empty stack, span index + 1, 0 = none
+            u32 Prev;  // partial list, span index + 1, 0 = none
+            u16 Used;  // number of items in use
+            u16 Hint;  // all bitmap words before this one are zero
+            u16 Count; // number of items in the span
+            u16 Padding;
+            u64 Free[cHeapBitmapWords]; // bit set = item is free
+        };
+
+        struct heap_class_t
+        {
+            std::mutex   Mutex;
+            heap_span_t* Spans;         // metadata of the spans of this class
+            u8*          Base;          // region of the class
+            u32          ItemSize;      // size of an item of this class
+            u32          ItemRecip;     // ceil(2^32 / ItemSize), offset in span to item index without a division
+            u32          ItemsPerSpan;  // number of items that fit in a span
+            u32          Partial;       // list of spans with free items, span index + 1
+            u32          Empty;         // stack of decommited spans, span index + 1
+            u32          Spare;         // empty span that is kept commited, span index + 1
+            u32          SpanCount;     // spans that have been used at least once
+            u32          SpanMax;       // spans that fit in the region
+            u64          MetaCommitted; // bytes of span metadata that are commited
+            u64          AllocCount;    // telemetry
+            u64          LiveCount;     // telemetry
+            u64          CommitBytes;   // telemetry
+        };
+
+        // In front of every large allocation, the allocations are linked so that teardown can release them.
+        struct heap_large_t
+        {
+            heap_large_t* Next;
+            heap_large_t* Prev;
+            u8*           Base;   // reservation
+            u64           Range;  // size of the reservation
+            u64           Size;   // size that was asked for
+            u64           Commit; // commited bytes, from the page holding this header
+            u64           Magic;
+            u64           Padding;
+        };
+
+        static const u64 cHeapLargeMagic = 0x4c41524745484541ull;
+
+        struct heap_state_t
+        {
+            heap_class_t  Classes[cHeapClassCount];
+            std::mutex    LargeMutex;
+            heap_large_t* Large;           // list of large allocations
+            u64           LargeAllocCount; // telemetry
+            u64           LargeCount;      // telemetry
+            u64           LargeBytes;      // telemetry
+            u64           LargeCommit;     // telemetry
+            u8*           Items;           // reservation of all size classes
+            u64           ItemsRange;      // size of the reservation of all size classes
+            s8            ClassShift;      // region of a size class is (1 << ClassShift) bytes
+            u64           StateRange;      // reservation of this state and the span metadata
+            u64           PageSize;        // system page size
+        };
+
+        heap_t::heap_t()
+            : m_state(nullptr)
+        {
+        }
+
+        heap_t::~heap_t() { teardown(); }
+
+        bool heap_t::setup(u64 class_reserve)
+        {
+            if (m_state != nullptr)
+                return false;
+
+            nvmem::initialize();
+            const u64 page_size = nvmem::get_page_size();
+            if (page_size > cHeapSpanSize)
+                return false;
+
+            // a region of a size class is a power of two, so that an address maps to its class with a shift
+            s8 class_shift = cHeapSpanShift;
+            while (((u64)1 << class_shift) < class_reserve && class_shift < 40)
+                ++class_shift;
+            const u32 span_max    = (u32)(((u64)1 << class_shift) >> cHeapSpanShift);
+            const u64 meta_stride = ((u64)span_max * sizeof(heap_span_t) + page_size - 1) & ~(page_size - 1);
+            const u64 state_bytes = (sizeof(heap_state_t) + page_size - 1) & ~(page_size - 1);
+            const u64 state_range = state_bytes + meta_stride * cHeapClassCount;
+            const u64 items_range = ((u64)1 << class_shift) * cHeapClassCount;
+
+            void* state_mem = nullptr;
+            if (!nvmem::reserve(state_range, nvmem::nprotect::ReadWrite, state_mem))
+                return false;
+            // the items are reserved aligned to the span size, a size class with an alignment of up to the span size then
+            // has its items aligned
+            void*                 items_mem = nullptr;
+            nvmem::npage::value_t items_kind;
+            if (!nvmem::commit(state_mem, state_bytes) || !nvmem::reserve(items_range, nvmem::nprotect::ReadWrite, cHeapSpanShift, items_mem, items_kind))
+            {
+                nvmem::release(state_mem, state_range);
+                return false;
+            }
+
+            heap_state_t* state    = new (state_mem) heap_state_t();
+            state->Large           = nullptr;
+            state->LargeAllocCount = 0;
+            state->LargeCount      = 0;
+            state->LargeBytes      = 0;
+            state->LargeCommit     = 0;
+            state->Items           = (u8*)items_mem;
+            state->ItemsRange      = items_range;
+            state->ClassShift      = class_shift;
+            state->StateRange      = state_range;
+            state->PageSize        = page_size;
+
+            for (u32 i = 0; i < cHeapClassCount; ++i)
+            {
+                heap_class_t& c = state->Classes[i];
+                c.Spans         = (heap_span_t*)((u8*)state_mem + state_bytes + meta_stride * i);
+                c.Base          = state->Items + ((u64)i << class_shift);
+                c.ItemSize      = s_heap_class_size[i];
+                c.ItemRecip     = (u32)((((u64)1 << 32) / c.ItemSize) + 1);
+                c.ItemsPerSpan  = cHeapSpanSize / c.ItemSize;
+                c.Partial       = 0;
+                c.Empty         = 0;
+                c.Spare         = 0;
+                c.SpanCount     = 0;
+                c.SpanMax       = span_max;
+                c.MetaCommitted = 0;
+                c.AllocCount    = 0;
+                c.LiveCount     = 0;
+                c.CommitBytes   = 0;
+            }
+
+            m_state = state;
+            return true;
+        }
+
+        bool heap_t::teardown()
+        {
+            if (m_state == nullptr)
+                return true;
+
+            heap_state_t* state = m_state;
+            m_state             = nullptr;
+
+            bool ok = true;
+            for (heap_large_t* large = state->Large; large != nullptr;)
+            {
+                heap_large_t* next = large->Next;
+                ok                 = nvmem::release(large->Base, large->Range) && ok;
+                large              = next;
+            }
+            ok = nvmem::release(state->Items, state->ItemsRange) && ok;
+
+            const u64 state_range = state->StateRange;
+            state->~heap_state_t();
+            ok = nvmem::release(state, state_range) && ok;
+            return ok;
+        }
+
+        static inline void s_heap_link(heap_class_t& c, u32 index)
+        {
+            heap_span_t& span = c.Spans[index];
+            span.Prev         = 0;
+            span.Next         = c.Partial;
+            if (c.Partial != 0)
+                c.Spans[c.Partial - 1].Prev = index + 1;
+            c.Partial = index + 1;
+        }
+
+        static inline void s_heap_unlink(heap_class_t& c, u32 index)
+        {
+            heap_span_t& span = c.Spans[index];
+            if (span.Prev != 0)
+                c.Spans[span.Prev - 1].Next = span.Next;
+            else
+                c.Partial = span.Next;
+            if (span.Next != 0)
+                c.Spans[span.Next - 1].Prev = span.Prev;
+        }
+
+        // Take a decommited span or a span that was never used, commit it and put it on the partial list.
+        static bool s_heap_new_span(heap_class_t& c, u64 page_size)
+        {
+            u32 index;
+            if (c.Empty != 0)
+            {
+                index = c.Empty - 1;
+                if (!nvmem::commit(c.Base + ((u64)index << cHeapSpanShift), cHeapSpanSize))
+                    return false;
+                c.Empty = c.Spans[index].Next;
+            }
+            else
+            {
+                if (c.SpanCount == c.SpanMax)
+                    return false;
+                index                 = c.SpanCount;
+                const u64 meta_needed = ((u64)(index + 1) * sizeof(heap_span_t) + page_size - 1) & ~(page_size - 1);
+                if (meta_needed > c.MetaCommitted)
+                {
+                    if (!nvmem::commit((u8*)c.Spans + c.MetaCommitted, meta_needed - c.MetaCommitted))
+                        return false;
+                    c.MetaCommitted = meta_needed;
+                }
+                if (!nvmem::commit(c.Base + ((u64)index << cHeapSpanShift), cHeapSpanSize))
+                    return false;
+                c.SpanCount += 1;
+            }
+
+            heap_span_t& span = c.Spans[index];
+            span.Used         = 0;
+            span.Hint         = 0;
+            span.Count        = (u16)c.ItemsPerSpan;
+            for (u32 w = 0; w < cHeapBitmapWords; ++w)
+            {
+                const u32 first = w * 64;
+                span.Free[w]    = first + 64 <= c.ItemsPerSpan ? ~(u64)0 : (first < c.ItemsPerSpan ? (((u64)1 << (c.ItemsPerSpan - first)) - 1) : 0);
+            }
+            s_heap_link(c, index);
+            c.CommitBytes += cHeapSpanSize;
+            return true;
+        }
+
+        static void* s_heap_allocate_large(heap_state_t* state, u32 size, u32 alignment)
+        {
+            const u64 page_size = state->PageSize;
+            const u64 range     = (cHeapLargeHeader + (u64)alignment + size + page_size - 1) & ~(page_size - 1);
+            void*     base      = nullptr;
+            if (!nvmem::reserve(range, nvmem::nprotect::ReadWrite, base))
+                return nullptr;
+
+            u8* const     item   = (u8*)(((ptr_t)base + cHeapLargeHeader + alignment - 1) & ~((ptr_t)alignment - 1));
+            u8* const     first  = (u8*)((ptr_t)(item - cHeapLargeHeader) & ~((ptr_t)page_size - 1));
+            const u64     commit = (((ptr_t)item + size + page_size - 1) & ~((ptr_t)page_size - 1)) - (ptr_t)first;
+            heap_large_t* large  = (heap_large_t*)(item - cHeapLargeHeader);
+            if (!nvmem::commit(first, commit))
+            {
+                nvmem::release(base, range);
+                return nullptr;
+            }
+
+            large->Base   = (u8*)base;
+            large->Range  = range;
+            large->Size   = size;
+            large->Commit = commit;
+            large->Magic  = cHeapLargeMagic;
+
+            std::unique_lock<std::mutex> lock(state->LargeMutex);
+            large->Prev = nullptr;
+            large->Next = state->Large;
+            if (state->Large != nullptr)
+                state->Large->Prev = large;
+            state->Large = large;
+            state->LargeAllocCount += 1;
+            state->LargeCount += 1;
+            state->LargeBytes += size;
+            state->LargeCommit += commit;
+            return item;
+        }
+
+        static void s_heap_deallocate_large(heap_state_t* state, void* ptr)
+        {
+            heap_large_t* large = (heap_large_t*)((u8*)ptr - cHeapLargeHeader);
+            if (large->Magic != cHeapLargeMagic)
+            {
+                ASSERTS(false, "heap: deallocate of a pointer that is not from this heap");
+                return;
+            }
+
+            u8* const base  = large->Base;
+            const u64 range = large->Range;
+            {
+                std::unique_lock<std::mutex> lock(state->LargeMutex);
+                if (large->Prev != nullptr)
+                    large->Prev->Next = large->Next;
+                else
+                    state->Large = large->Next;
+                if (large->Next != nullptr)
+                    large->Next->Prev = large->Prev;
+                state->LargeCount -= 1;
+                state->LargeBytes -= large->Size;
+                state->LargeCommit -= large->Commit;
+            }
+            large->Magic = 0;
+            nvmem::release(base, range);
+        }
+
+        void* heap_t::v_allocate(u32 size, u32 alignment)
+        {
+            heap_state_t* state = m_state;
+            if (state == nullptr)
+                return nullptr;
+
+            alignment = alignment < cHeapMinAlignment ? (u32)cHeapMinAlignment : alignment;
+            if (size > cHeapSmallMax || alignment > cHeapSmallMax)
+                return s_heap_allocate_large(state, size, alignment);
+
+            // every power of two is a size class, so there is always a class that has the alignment
+            u32 cls = s_heap_class_of(size > alignment ? size : alignment);
+            while ((s_heap_class_size[cls] & (alignment - 1)) != 0)
+                ++cls;
+
+            heap_class_t&                c = state->Classes[cls];
+            std::unique_lock<std::mutex> lock(c.Mutex);
+            if (c.Partial == 0 && !s_heap_new_span(c, state->PageSize))
+                return nullptr;
+
+            const u32    index = c.Partial - 1;
+            heap_span_t& span  = c.Spans[index];
+            u32          w     = span.Hint;
+            while (span.Free[w] == 0)
+                ++w;
+            const u32 bit = (u32)s_heap_lowest_bit(span.Free[w]);
+            span.Free[w] &= span.Free[w] - 1;
+            span.Hint = (u16)w;
+
+            if (span.Used == 0 && c.Spare == index + 1)
+                c.Spare = 0;
+            span.Used += 1;
+            if (span.Used == span.Count)
+                s_heap_unlink(c, index);
+
+            c.AllocCount += 1;
+            c.LiveCount += 1;
+            return c.Base + ((u64)index << cHeapSpanShift) + (u64)(w * 64 + bit) * c.ItemSize;
+        }
+
+        void heap_t::v_deallocate(void* ptr)
+        {
+            heap_state_t* state = m_state;
+            if (ptr == nullptr || state == nullptr)
+                return;
+
+            const u64 offset = (u64)((u8*)ptr - state->Items);
+            if ((u8*)ptr < state->Items || offset >= state->ItemsRange)
+            {
+                s_heap_deallocate_large(state, ptr);
+                return;
+            }
+
+            heap_class_t& c       = state->Classes[offset >> state->ClassShift];
+            const u64     in_cls  = offset & (((u64)1 << state->ClassShift) - 1);
+            const u32     index   = (u32)(in_cls >> cHeapSpanShift);
+            const u32     in_span = (u32)(in_cls & (cHeapSpanSize - 1));
+            const u32     item    = (u32)(((u64)in_span * c.ItemRecip) >> 32);
+            const u32     w       = item >> 6;
+            const u64     mask    = (u64)1 << (item & 63);
+
+            std::unique_lock<std::mutex> lock(c.Mutex);
+            heap_span_t&                 span = c.Spans[index];
+            if (index >= c.SpanCount || item * c.ItemSize != in_span || (span.Free[w] & mask) != 0)
+            {
+                ASSERTS(false, "heap: deallocate of an invalid pointer or a double deallocate");
+                return;
+            }
+
+            span.Free[w] |= mask;
+            span.Hint = w < span.Hint ? (u16)w : span.Hint;
+            if (span.Used == span.Count)
+                s_heap_link(c, index);
+            span.Used -= 1;
+            c.LiveCount -= 1;
+
+            if (span.Used == 0)
+            {
+                // keep one empty span per class commited, decommit the others
+                if (c.Spare == 0)
+                {
+                    c.Spare = index + 1;
+                }
+                else
+                {
+                    s_heap_unlink(c, index);
+                    nvmem::decommit(c.Base + ((u64)index << cHeapSpanShift), cHeapSpanSize);
+                    span.Next = c.Empty;
+                    c.Empty   = index + 1;
+                    c.CommitBytes -= cHeapSpanSize;
+                }
+            }
+        }
+
+        void heap_t::v_release() { teardown(); }
+
+        u32 heap_t::usable_size(void const* ptr) const
+        {
+            heap_state_t* state = m_state;
+            if (ptr == nullptr || state == nullptr)
+                return 0;
+
+            const u64 offset = (u64)((u8 const*)ptr - state->Items);
+            if ((u8 const*)ptr >= state->Items && offset < state->ItemsRange)
+                return state->Classes[offset >> state->ClassShift].ItemSize;
+
+            heap_large_t const* large = (heap_large_t const*)((u8 const*)ptr - cHeapLargeHeader);
+            const ptr_t         first = (ptr_t)large & ~((ptr_t)state->PageSize - 1);
+            return (u32)(first + large->Commit - (ptr_t)ptr);
+        }
+
+        void heap_t::get_stats(heap_stats_t& stats) const
+        {
+            stats = {0, 0, 0, 0, 0};
+            heap_state_t* state = m_state;
+            if (state == nullptr)
+                return;
+
+            for (u32 i = 0; i < cHeapClassCount; ++i)
+            {
+                heap_class_t&                c = state->Classes[i];
+                std::unique_lock<std::mutex> lock(c.Mutex);
+                stats.alloc_count += c.AllocCount;
+                stats.live_count += c.LiveCount;
+                stats.live_bytes += c.LiveCount * c.ItemSize;
+                stats.commit_bytes += c.CommitBytes;
+            }
+
+            std::unique_lock<std::mutex> lock(state->LargeMutex);
+            stats.alloc_count += state->LargeAllocCount;
+            stats.live_count += state->LargeCount;
+            stats.live_bytes += state->LargeBytes;
+            stats.commit_bytes += state->LargeCommit;
+            stats.large_count = state->LargeCount;
+        }
+
+    } // namespace nvmem
+} // namespace ncore
@@ -1,9 +1,13 @@
 #include "ccore/c_target.h"
 #include "ccore/c_debug.h"
 #include "ccore/c_allocator.h"
+#include "ccore/c_math.h"
 
 #include "cvmem/c_virtual_memory.h"
 
+#include <atomic>
+#include <thread>
+
 #if defined TARGET_MAC
 #    include <sys/mman.h>
 #    include <mach/mach_host.h>
@@ -11,8 +15,29 @@
 #    include <mach/mach_vm.h>
 #    include <mach/vm_map.h>
 #    include <mach/vm_page_size.h>
+#    include <fcntl.h>
+#    include <signal.h>
+#    include <stdlib.h>
+#    include <sys/stat.h>
 #    include <unistd.h>
+#    include <time.h>
 #    define VMEM_PLATFORM_MAC
+#    define VMEM_PLATFORM_POSIX
+#endif
+
+#if defined TARGET_LINUX
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <fcntl.h>
+#    include <signal.h>
+#    include <stdlib.h>
+#    include <sys/stat.h>
+#    include <ucontext.h>
+#    include <unistd.h>
+#    include <errno.h>
+#    include <time.h>
+#    define VMEM_PLATFORM_LINUX
+#    define VMEM_PLATFORM_POSIX
 #endif
 
 #if defined TARGET_PC
@@ -43,11 +68,11 @@ namespace ncore
             return !cond;
         }
 #    else
-        static bool check(bool cond, s32 error) { return true; }
+        static bool check(bool cond, s32 error) { return !cond; }
 #    endif
 
 #else
-        static bool check(bool cond, s32 error) { return true; }
+        static bool check(bool cond, s32 error) { return !cond; }
 #endif
 
         enum eVmemMemoryError
@@ -69,7 +94,10 @@ namespace ncore
             ErrorVirtualAllocReturnedNull                = 14,
             ErrorVirtualLockFailed                       = 15,
             ErrorVirtualUnlockFailed                     = 16,
-            ErrorMaxErrors                               = 17,
+            ErrorVirtualDecommitFailed                   = 17,
+            ErrorNumaPolicyFailed                        = 18,
+            ErrorFileFailed                              = 19,
+            ErrorMaxErrors                               = 20,
         };
 
         const char* sVmemMemoryErrorStrings[] = {
@@ -90,6 +118,9 @@ namespace ncore
             "VirtualAlloc returned null",
             "VirtualLock failed",
             "VirtualUnlock failed",
+            "Releasing decommitted pages failed",
+            "Setting the NUMA policy failed",
+            "File operation failed",
         };
 
 #if !defined(VMEM_NO_ERROR_MESSAGES)
@@ -108,11 +139,25 @@ namespace ncore
 
         // Cached global page size.
         static u32 s_page_size              = 0;
+        static s8  s_page_size_shift        = 0;
         static u32 s_allocation_granularity = 0;
 
+        // How `decommit` gives physical pages back to the OS.
+        static ndecommit::value_t s_decommit_mode = ndecommit::DontNeed;
+
+        // Overrun detection with guard pages, see `set_guard_mode`.
+        static bool s_guard_mode = false;
+
         u32 get_page_size(void) { return s_page_size; }
+        s8  get_page_size_shift(void) { return s_page_size_shift; }
         u32 get_allocation_granularity(void) { return s_allocation_granularity; }
 
+        void               set_decommit_mode(ndecommit::value_t mode) { s_decommit_mode = (mode == ndecommit::Free) ? ndecommit::Free : ndecommit::DontNeed; }
+        ndecommit::value_t get_decommit_mode() { return s_decommit_mode; }
+
+        void set_guard_mode(bool enabled) { s_guard_mode = enabled; }
+        bool get_guard_mode() { return s_guard_mode; }
+
         const char* sVmemProtectStrings[] = {
             "Invalid", "NoAccess", "Read", "ReadWrite", "Execute", "ExecuteRead", "ExecuteReadWrite",
         };
@@ -279,54 +324,138 @@ namespace ncore
             return true;
         }
 
+        bool reserve(u64 address_range, nprotect::value_t attributes, s8 page_size_shift, void*& baseptr, npage::value_t& page_kind)
+        {
+            // MEM_LARGE_PAGES can only be used when reserving and committing in one go, which doesn't fit the
+            // reserve/commit model, so Windows always hands out normal pages.
+            page_kind = npage::Normal;
+            if (page_size_shift > 0)
+            {
+                const u64 page_size = (u64)1 << page_size_shift;
+                address_range       = (address_range + (page_size - 1)) & ~(page_size - 1);
+            }
+            return reserve(address_range, attributes, baseptr);
+        }
+
 #endif // defined(VMEM_PLATFORM_WIN32)
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// MacOS backend implementation
+// POSIX (MacOS and Linux) backend implementation
 //
-#if defined(VMEM_PLATFORM_MAC)
+#if defined(VMEM_PLATFORM_POSIX)
         static const s32 s_protect_array[] = {-1, PROT_NONE, PROT_READ, PROT_READ | PROT_WRITE, PROT_EXEC, PROT_EXEC | PROT_READ, PROT_EXEC | PROT_READ | PROT_WRITE};
-        static s32 _mac_protect(const nprotect::value_t protect)
+        static s32       _posix_protect(const nprotect::value_t protect)
         {
-            s32 const protect_mac = s_protect_array[protect];
-            if (protect_mac == -1)
+            if (protect <= nprotect::Invalid || protect > nprotect::ExecuteReadWrite)
             {
-                check(false, ErrorInvalidProtectMode);
-                return 0;
+                check(true, ErrorInvalidProtectMode);
+                return -1;
             }
-            return protect_mac;
+            return s_protect_array[protect];
         }
 
-        static nprotect::value_t _protect_from_mac(const s32 protect)
+        // Give the physical pages backing [ptr, ptr + num_bytes) back to the OS, the address range stays reserved.
+        static bool _posix_release_pages(void* ptr, const int_t num_bytes)
         {
-            switch (protect)
+#    if defined(VMEM_PLATFORM_LINUX)
+            if (s_decommit_mode == ndecommit::Free)
             {
-                case PROT_NONE: return nprotect::NoAccess;
-                case PROT_READ: return nprotect::Read;
-                case PROT_READ | PROT_WRITE: return nprotect::ReadWrite;
-                case PROT_EXEC: return nprotect::Execute;
-                case PROT_EXEC | PROT_READ: return nprotect::ExecuteRead;
-                case PROT_EXEC | PROT_READ | PROT_WRITE: return nprotect::ExecuteReadWrite;
+                // MADV_FREE needs Linux 4.5+, fall back to MADV_DONTNEED when the kernel doesn't know it.
+                if (madvise(ptr, num_bytes, MADV_FREE) == 0)
+                    return true;
+                if (errno != EINVAL)
+                    return false;
             }
-            check(false, ErrorInvalidProtectMode);
-            return nprotect::Invalid;
+            return madvise(ptr, num_bytes, MADV_DONTNEED) == 0;
+#    else
+            if (s_decommit_mode == ndecommit::Free)
+            {
+                return madvise(ptr, num_bytes, MADV_FREE_REUSABLE) == 0;
+            }
+            // MADV_DONTNEED on MacOS doesn't drop the pages, mapping fresh anonymous memory over the range does.
+            void* address = mmap(ptr, num_bytes, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+            return address != MAP_FAILED;
+#    endif
         }
 
-        void* alloc_protect(const int_t num_bytes, const nprotect::value_t protect)
+        // Reserve `num_bytes` of address space aligned to `alignment` by reserving a larger range and trimming the head and tail.
+        static void* _posix_reserve_aligned(const int_t num_bytes, const int_t alignment)
         {
-            if (!check(num_bytes == 0, ErrorCannotAllocateMemoryBlockWithSize0Bytes))
+            const int_t page_size = (int_t)query_page_size();
+            if (alignment <= page_size)
+            {
+                void* address = mmap(nullptr, num_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+                return address == MAP_FAILED ? nullptr : address;
+            }
+
+            void* address = mmap(nullptr, num_bytes + alignment, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+            if (address == MAP_FAILED)
                 return nullptr;
 
-            const s32 protect_mac = _mac_protect(protect);
-            if (protect_mac)
+            u8*         base    = (u8*)address;
+            u8*         aligned = (u8*)align_forward((ptr_t)base, (u32)alignment);
+            const int_t head    = (int_t)(aligned - base);
+            const int_t tail    = alignment - head;
+            if (head > 0)
+                munmap(base, head);
+            if (tail > 0)
+                munmap(aligned + num_bytes, tail);
+            return aligned;
+        }
+
+        bool reserve(u64 address_range, nprotect::value_t attributes, s8 page_size_shift, void*& baseptr, npage::value_t& page_kind)
+        {
+            baseptr   = nullptr;
+            page_kind = npage::Normal;
+
+            const s8 system_page_size_shift = math::g_ilog2(query_page_size());
+            if (page_size_shift <= system_page_size_shift)
+                return reserve(address_range, attributes, baseptr);
+
+            if (!check(address_range == 0, ErrorCannotAllocateMemoryBlockWithSize0Bytes))
+                return false;
+            if (_posix_protect(attributes) < 0)
+                return false;
+
+            const u64 page_size = (u64)1 << page_size_shift;
+            address_range       = (address_range + (page_size - 1)) & ~(page_size - 1);
+
+#    if defined(VMEM_PLATFORM_LINUX) && defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+            // Explicit huge pages, without MAP_NORESERVE this only succeeds when the hugetlb pool can back the whole range.
+            void* address = mmap(nullptr, address_range, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB | ((s32)page_size_shift << MAP_HUGE_SHIFT), -1, 0);
+            if (address != MAP_FAILED)
             {
-                void* address = mmap(nullptr, num_bytes, protect_mac, MAP_PRIVATE | MAP_ANON, -1, 0);
-                if (!check(address == MAP_FAILED, ErrorVirtualAllocFailed))
-                    return nullptr;
-                return address;
+                baseptr   = address;
+                page_kind = npage::Huge;
+                return true;
             }
+#    endif
 
-            return 0;
+            baseptr = _posix_reserve_aligned(address_range, page_size);
+            if (!check(baseptr == nullptr, ErrorVirtualAllocFailed))
+                return false;
+
+#    if defined(VMEM_PLATFORM_LINUX) && defined(MADV_HUGEPAGE)
+            if (madvise(baseptr, address_range, MADV_HUGEPAGE) == 0)
+                page_kind = npage::Transparent;
+#    endif
+            return true;
+        }
+
+        void* alloc_protect(const int_t num_bytes, const nprotect::value_t protect)
+        {
+            if (!check(num_bytes == 0, ErrorCannotAllocateMemoryBlockWithSize0Bytes))
+                return nullptr;
+
+            // Reserve only, like MEM_RESERVE on Windows the range stays inaccessible whatever `protect` is, the pages
+            // get their protection when they are commited with `commit_protect`.
+            if (_posix_protect(protect) < 0)
+                return nullptr;
+
+            void* address = mmap(nullptr, num_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+            if (!check(address == MAP_FAILED, ErrorVirtualAllocFailed))
+                return nullptr;
+            return address;
         }
 
         bool dealloc(void* ptr, const int_t num_allocated_bytes)
@@ -349,16 +478,14 @@ namespace ncore
             if (!check(num_bytes == 0, ErrorSizeCannotBe0))
                 return false;
 
-            const s32 protect_mac = _mac_protect(protect);
-            if (protect_mac)
-            {
-                const s32 result = mprotect(ptr, num_bytes, protect_mac);
-                if (!check(result == -1, ErrorVirtualProtectFailed))
-                    return false;
-                return true;
-            }
+            const s32 protect_posix = _posix_protect(protect);
+            if (protect_posix < 0)
+                return false;
 
-            return false;
+            const s32 result = mprotect(ptr, num_bytes, protect_posix);
+            if (!check(result == -1, ErrorVirtualProtectFailed))
+                return false;
+            return true;
         }
 
         bool decommit(void* ptr, const int_t num_bytes)
@@ -371,6 +498,8 @@ namespace ncore
             const s32 result = mprotect(ptr, num_bytes, PROT_NONE);
             if (!check(result == -1, ErrorVirtualProtectFailed))
                 return false;
+            if (!check(!_posix_release_pages(ptr, num_bytes), ErrorVirtualDecommitFailed))
+                return false;
             return true;
         }
 
@@ -381,18 +510,17 @@ namespace ncore
             if (!check(num_bytes == 0, ErrorSizeCannotBe0))
                 return false;
 
-            const s32 protect_mac = _mac_protect(protect);
-            if (protect_mac)
-            {
-                const s32 result = mprotect(ptr, num_bytes, protect_mac);
-                if (!check(result == -1, ErrorVirtualProtectFailed))
-                    return false;
-                return true;
-            }
+            const s32 protect_posix = _posix_protect(protect);
+            if (protect_posix < 0)
+                return false;
 
-            return false;
+            const s32 result = mprotect(ptr, num_bytes, protect_posix);
+            if (!check(result == -1, ErrorVirtualProtectFailed))
+                return false;
+            return true;
         }
 
+#    if defined(VMEM_PLATFORM_MAC)
         u32 query_page_size(void) { return (int_t)vm_page_size; }
         u32 query_allocation_granularity(void) { return (int_t)vm_page_size; }
 
@@ -412,6 +540,24 @@ namespace ncore
 
             return usage_status;
         }
+#    else
+        u32 query_page_size(void) { return (u32)sysconf(_SC_PAGESIZE); }
+        u32 query_allocation_granularity(void) { return (u32)sysconf(_SC_PAGESIZE); }
+
+        usage_t query_usage_status(void)
+        {
+            usage_t   usage_status = {0};
+            const s64 page_size    = sysconf(_SC_PAGESIZE);
+            const s64 total_pages  = sysconf(_SC_PHYS_PAGES);
+            const s64 avail_pages  = sysconf(_SC_AVPHYS_PAGES);
+            if (page_size > 0 && total_pages > 0 && avail_pages >= 0)
+            {
+                usage_status.total_physical_bytes = (int_t)total_pages * (int_t)page_size;
+                usage_status.avail_physical_bytes = (int_t)avail_pages * (int_t)page_size;
+            }
+            return usage_status;
+        }
+#    endif
 
         bool lock(void* ptr, const int_t num_bytes)
         {
@@ -441,6 +587,503 @@ namespace ncore
 
 #endif
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// NUMA
+//
+#if defined(VMEM_PLATFORM_LINUX)
+        // No dependency on libnuma, the policies are set with the system calls directly (values from numaif.h).
+        enum
+        {
+            cMpolDefault         = 0,
+            cMpolPreferred       = 1,
+            cMpolBind            = 2,
+            cMpolInterleave      = 3,
+            cMpolFMemsAllowed    = 4,
+            cMpolMfMove          = 2,
+            cMpolMaxNodes        = 1024, // size of the node mask given to get_mempolicy, must cover all possible nodes
+            cMovePagesBatchCount = 256,
+        };
+
+        // Nodes the process may use, 0 when not queried yet.
+        static std::atomic<u64> s_numa_nodes(0);
+
+        static u64 _numa_allowed_nodes()
+        {
+            u64 nodes = s_numa_nodes.load(std::memory_order_relaxed);
+            if (nodes == 0)
+            {
+                s32 mode                     = 0;
+                u64 mask[cMpolMaxNodes / 64] = {0};
+                if (syscall(SYS_get_mempolicy, &mode, mask, (u64)cMpolMaxNodes, nullptr, (u64)cMpolFMemsAllowed) == 0 && mask[0] != 0)
+                    nodes = mask[0];
+                else
+                    nodes = 1; // no NUMA support, everything is node 0
+                s_numa_nodes.store(nodes, std::memory_order_relaxed);
+            }
+            return nodes;
+        }
+
+        s32 numa_node_count()
+        {
+            s32 count = 0;
+            for (u64 nodes = _numa_allowed_nodes(); nodes != 0; nodes &= nodes - 1)
+                count += 1;
+            return count;
+        }
+
+        bool numa_apply(void* address, u64 size, numa_t const& numa)
+        {
+            if (!check(address == 0, ErrorPtrCannotBeNull))
+                return false;
+            if (!check(size == 0, ErrorSizeCannotBe0))
+                return false;
+
+            const u64 allowed = _numa_allowed_nodes();
+            u64       nodes   = numa.nodes & allowed;
+            s32       mode    = cMpolDefault;
+            switch (numa.policy)
+            {
+                case nnuma::Bind: mode = cMpolBind; break;
+                case nnuma::Interleave:
+                    mode  = cMpolInterleave;
+                    nodes = numa.nodes == 0 ? allowed : nodes;
+                    break;
+                case nnuma::Preferred:
+                    mode  = cMpolPreferred;
+                    nodes = nodes & (~nodes + 1); // the first given node
+                    break;
+            }
+            if (mode != cMpolDefault && nodes == 0)
+                return true; // none of the nodes exist
+
+            const long result = syscall(SYS_mbind, address, size, (u64)mode, mode != cMpolDefault ? &nodes : nullptr, mode != cMpolDefault ? (u64)65 : (u64)0, (u64)cMpolMfMove);
+            if (result == 0 || errno == ENOSYS) // ENOSYS: kernel without NUMA support
+                return true;
+            check(true, ErrorNumaPolicyFailed);
+            return false;
+        }
+
+        s32 query_node(void const* address)
+        {
+            void* page   = (void*)align_backward((ptr_t)address, query_page_size());
+            s32   status = -1;
+            if (syscall(SYS_move_pages, 0, (u64)1, &page, nullptr, &status, 0) != 0)
+                return -1;
+            return status >= 0 ? status : -1; // -ENOENT when the page is not backed
+        }
+
+        u64 query_nodes(void const* address, u64 size, u64* pages_per_node, s32 max_nodes)
+        {
+            for (s32 i = 0; i < max_nodes; ++i)
+                pages_per_node[i] = 0;
+
+            // move_pages without target nodes only reports the node of every page
+            const u64 page_size = query_page_size();
+            const u8* page      = (const u8*)align_backward((ptr_t)address, (u32)page_size);
+            const u8* end       = (const u8*)address + size;
+            void*     pages[cMovePagesBatchCount];
+            s32       status[cMovePagesBatchCount];
+            u64       backed = 0;
+            while (page < end)
+            {
+                u64 count = 0;
+                for (; count < cMovePagesBatchCount && page < end; ++count, page += page_size)
+                    pages[count] = (void*)page;
+                if (syscall(SYS_move_pages, 0, count, pages, nullptr, status, 0) != 0)
+                    return backed;
+                for (u64 i = 0; i < count; ++i)
+                {
+                    if (status[i] < 0)
+                        continue;
+                    backed += 1;
+                    if (status[i] < max_nodes)
+                        pages_per_node[status[i]] += 1;
+                }
+            }
+            return backed;
+        }
+#else
+        s32 numa_node_count()
+        {
+#    if defined(VMEM_PLATFORM_WIN32)
+            ULONG highest = 0;
+            if (GetNumaHighestNodeNumber(&highest))
+                return (s32)highest + 1;
+#    endif
+            return 1;
+        }
+
+        // Windows only supports a preferred node when memory is allocated (VirtualAllocExNuma), not on existing ranges
+        bool numa_apply(void* address, u64 size, numa_t const& numa) { return true; }
+        s32  query_node(void const* address) { return -1; }
+
+        u64 query_nodes(void const* address, u64 size, u64* pages_per_node, s32 max_nodes)
+        {
+            for (s32 i = 0; i < max_nodes; ++i)
+                pages_per_node[i] = 0;
+            return 0;
+        }
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Memory mapped files
+//
+#if defined(VMEM_PLATFORM_POSIX)
+        file_t file_open(const char* path, u64& size)
+        {
+            size         = 0;
+            const s32 fd = open(path, O_RDWR | O_CREAT, 0644);
+            if (!check(fd < 0, ErrorFileFailed))
+                return cInvalidFile;
+
+            struct stat st;
+            if (!check(fstat(fd, &st) != 0, ErrorFileFailed))
+            {
+                close(fd);
+                return cInvalidFile;
+            }
+            size = (u64)st.st_size;
+            return (file_t)fd;
+        }
+
+        bool file_close(file_t file) { return check(close((s32)file) != 0, ErrorFileFailed); }
+
+        bool file_resize(file_t file, u64 size) { return check(ftruncate((s32)file, (off_t)size) != 0, ErrorFileFailed); }
+
+        bool file_map(file_t file, u64 address_range, void* address, void*& baseptr)
+        {
+            baseptr = nullptr;
+            if (!check(address_range == 0, ErrorSizeCannotBe0))
+                return false;
+
+            // Without MAP_FIXED the address is a hint, it is used when the range is free
+            void* mapped = mmap(address, address_range, PROT_READ | PROT_WRITE, MAP_SHARED, (s32)file, 0);
+            if (!check(mapped == MAP_FAILED, ErrorFileFailed))
+                return false;
+            baseptr = mapped;
+            return true;
+        }
+
+        bool file_unmap(void* baseptr, u64 address_range) { return check(munmap(baseptr, address_range) != 0, ErrorFileFailed); }
+
+        bool flush(void* address, u64 size)
+        {
+            if (size == 0)
+                return true;
+            return check(msync(address, size, MS_SYNC) != 0, ErrorFileFailed);
+        }
+
+        file_t file_anonymous()
+        {
+#    if defined(VMEM_PLATFORM_LINUX) && defined(SYS_memfd_create)
+            const s32 fd = (s32)syscall(SYS_memfd_create, "cvmem", 1); // MFD_CLOEXEC
+            if (fd >= 0)
+                return (file_t)fd;
+#    endif
+            char      path[] = "/tmp/cvmem-XXXXXX";
+            const s32 tmp    = mkstemp(path);
+            if (!check(tmp < 0, ErrorFileFailed))
+                return cInvalidFile;
+            unlink(path);
+            return (file_t)tmp;
+        }
+
+        bool file_sync(file_t file) { return check(fsync((s32)file) != 0, ErrorFileFailed); }
+
+        bool file_remap(file_t file, u64 offset, void* address, u64 size, bool copy_on_write)
+        {
+            if (size == 0)
+                return true;
+            void* mapped = mmap(address, size, PROT_READ | PROT_WRITE, (copy_on_write ? MAP_PRIVATE : MAP_SHARED) | MAP_FIXED, (s32)file, (off_t)offset);
+            return check(mapped == MAP_FAILED, ErrorFileFailed);
+        }
+
+        // Write [address, address + size) to the file at `offset`, pwrite can write less than asked for.
+        static bool _posix_write_range(s32 fd, u64 offset, u8 const* address, u64 size)
+        {
+            while (size > 0)
+            {
+                const ssize_t written = pwrite(fd, address, size, (off_t)offset);
+                if (written <= 0)
+                    return false;
+                offset += (u64)written;
+                address += written;
+                size -= (u64)written;
+            }
+            return true;
+        }
+
+        bool file_writeback(file_t file, u64 offset, void const* address, u64 size)
+        {
+            u8 const* const begin = (u8 const*)address;
+#    if defined(VMEM_PLATFORM_LINUX)
+            // A page that was copied on write is anonymous, present or swapped, the pages that still come from the file
+            // have bit 61 set and untouched pages are not present.
+            const s32 pagemap = open("/proc/self/pagemap", O_RDONLY);
+            if (pagemap >= 0)
+            {
+                const u64 page_size = s_page_size != 0 ? s_page_size : query_page_size();
+                const u64 num_pages = (size + page_size - 1) / page_size;
+                const u64 first     = (u64)(ptr_t)begin / page_size;
+                u64       entries[512];
+                u64       run_begin = 0;
+                u64       run_count = 0;
+                bool      ok        = true;
+                for (u64 p = 0; p < num_pages && ok; p += 512)
+                {
+                    const u64 count = (num_pages - p) < 512 ? (num_pages - p) : 512;
+                    ok              = pread(pagemap, entries, count * sizeof(u64), (off_t)((first + p) * sizeof(u64))) == (ssize_t)(count * sizeof(u64));
+                    for (u64 i = 0; i < count && ok; ++i)
+                    {
+                        const u64  e      = entries[i];
+                        const bool copied = ((e >> 63) & 1) != 0 ? ((e >> 61) & 1) == 0 : ((e >> 62) & 1) != 0;
+                        if (copied && run_count > 0 && run_begin + run_count == p + i)
+                        {
+                            run_count += 1;
+                            continue;
+                        }
+                        if (run_count > 0)
+                            ok = _posix_write_range((s32)file, offset + run_begin * page_size, begin + run_begin * page_size, run_count * page_size);
+                        run_begin = p + i;
+                        run_count = copied ? 1 : 0;
+                    }
+                }
+                if (ok && run_count > 0)
+                    ok = _posix_write_range((s32)file, offset + run_begin * page_size, begin + run_begin * page_size, math::g_min<u64>(run_count * page_size, size - run_begin * page_size));
+                close(pagemap);
+                return check(!ok, ErrorFileFailed);
+            }
+#    endif
+            return check(!_posix_write_range((s32)file, offset, begin, size), ErrorFileFailed);
+        }
+#else
+        file_t file_open(const char* path, u64& size)
+        {
+            size          = 0;
+            HANDLE handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (!check(handle == INVALID_HANDLE_VALUE, ErrorFileFailed))
+                return cInvalidFile;
+
+            LARGE_INTEGER file_size;
+            if (!check(GetFileSizeEx(handle, &file_size) == 0, ErrorFileFailed))
+            {
+                CloseHandle(handle);
+                return cInvalidFile;
+            }
+            size = (u64)file_size.QuadPart;
+            return (file_t)handle;
+        }
+
+        bool file_close(file_t file) { return check(CloseHandle((HANDLE)file) == 0, ErrorFileFailed); }
+
+        bool file_resize(file_t file, u64 size)
+        {
+            LARGE_INTEGER position;
+            position.QuadPart = (LONGLONG)size;
+            if (!check(SetFilePointerEx((HANDLE)file, position, NULL, FILE_BEGIN) == 0, ErrorFileFailed))
+                return false;
+            return check(SetEndOfFile((HANDLE)file) == 0, ErrorFileFailed);
+        }
+
+        // A view of a file mapping can't outgrow the size of the mapping object, and the file can't be resized while
+        // a view of it exists, so the grow-the-file-under-the-mapping model does not map onto Windows.
+        bool file_map(file_t file, u64 address_range, void* address, void*& baseptr)
+        {
+            baseptr = nullptr;
+            return false;
+        }
+
+        bool file_unmap(void* baseptr, u64 address_range) { return false; }
+
+        bool flush(void* address, u64 size)
+        {
+            if (size == 0)
+                return true;
+            return check(FlushViewOfFile(address, (SIZE_T)size) == 0, ErrorFileFailed);
+        }
+
+        file_t file_anonymous() { return cInvalidFile; }
+
+        bool file_sync(file_t file) { return check(FlushFileBuffers((HANDLE)file) == 0, ErrorFileFailed); }
+
+        bool file_remap(file_t file, u64 offset, void* address, u64 size, bool copy_on_write) { return false; }
+
+        bool file_writeback(file_t file, u64 offset, void const* address, u64 size) { return false; }
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Mirrored mappings
+//
+#if defined(VMEM_PLATFORM_POSIX)
+        bool mirror_alloc(u64& size, void*& baseptr)
+        {
+            baseptr = nullptr;
+            if (!check(size == 0, ErrorSizeCannotBe0))
+                return false;
+            const u64 granularity = (u64)get_allocation_granularity();
+            size                  = (size + (granularity - 1)) & ~(granularity - 1);
+
+            const file_t file = file_anonymous();
+            if (file == cInvalidFile)
+                return false;
+
+            // Reserve both halves in one go so nothing else can be mapped in between, then map the file over each half
+            void* base = mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            bool  ok   = check(base == MAP_FAILED, ErrorVirtualAllocFailed);
+            ok         = ok && file_resize(file, size);
+            ok         = ok && file_remap(file, 0, base, size, false);
+            ok         = ok && file_remap(file, 0, (u8*)base + size, size, false);
+            file_close(file); // the mappings keep the memory alive
+            if (!ok)
+            {
+                if (base != MAP_FAILED)
+                    munmap(base, size * 2);
+                return false;
+            }
+            baseptr = base;
+            return true;
+        }
+
+        bool mirror_release(void* baseptr, u64 size) { return check(munmap(baseptr, size * 2) != 0, ErrorVirtualFreeFailed); }
+#else
+        bool mirror_alloc(u64& size, void*& baseptr)
+        {
+            baseptr = nullptr;
+            if (!check(size == 0, ErrorSizeCannotBe0))
+                return false;
+            const u64 granularity = (u64)get_allocation_granularity();
+            size                  = (size + (granularity - 1)) & ~(granularity - 1);
+
+            HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+            if (!check(mapping == NULL, ErrorVirtualAllocFailed))
+                return false;
+
+            // Find a free range of twice the size and map both views into it, another thread can take the range between
+            // releasing the reservation and mapping the views, so retry a few times.
+            for (s32 attempt = 0; attempt < 16 && baseptr == nullptr; ++attempt)
+            {
+                u8* base = (u8*)VirtualAlloc(NULL, (SIZE_T)(size * 2), MEM_RESERVE, PAGE_NOACCESS);
+                if (base == nullptr)
+                    break;
+                VirtualFree(base, 0, MEM_RELEASE);
+                void* lower = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size, base);
+                void* upper = lower != NULL ? MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size, base + size) : NULL;
+                if (upper != NULL)
+                    baseptr = base;
+                else if (lower != NULL)
+                    UnmapViewOfFile(lower);
+            }
+            CloseHandle(mapping); // the views keep the memory alive
+            return check(baseptr == nullptr, ErrorVirtualAllocFailed);
+        }
+
+        bool mirror_release(void* baseptr, u64 size)
+        {
+            const bool upper = UnmapViewOfFile((u8*)baseptr + size) != 0;
+            const bool lower = UnmapViewOfFile(baseptr) != 0;
+            return check(!(upper && lower), ErrorVirtualFreeFailed);
+        }
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Write faults
+//
+        static std::atomic<write_fault_fn> s_write_fault_fn(nullptr);
+        static std::atomic<bool>           s_write_fault_installed(false);
+
+#if defined(VMEM_PLATFORM_POSIX)
+        static struct sigaction s_prev_segv_action;
+        static struct sigaction s_prev_bus_action;
+
+        // A store to a mapped page that is not writable, whether it is a store is only known where the fault reports it.
+        static bool _posix_is_write_fault(int sig, siginfo_t const* info, void const* context)
+        {
+            if (sig == SIGSEGV && info->si_code != SEGV_ACCERR)
+                return false; // unmapped address
+#    if defined(VMEM_PLATFORM_LINUX) && defined(__x86_64__) && defined(REG_ERR)
+            // bit 1 of the page fault error code is set for a write access
+            return (((ucontext_t const*)context)->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+#    else
+            (void)context;
+            return true;
+#    endif
+        }
+
+        static void _posix_fault_handler(int sig, siginfo_t* info, void* context)
+        {
+            const write_fault_fn fn = s_write_fault_fn.load(std::memory_order_acquire);
+            if (fn != nullptr && _posix_is_write_fault(sig, info, context) && fn(info->si_addr))
+                return; // the page is writable now, the store is retried
+
+            // Not ours, hand it to the handler that was installed before, the default handler is put back and the
+            // fault happens again when this returns
+            struct sigaction const& prev = sig == SIGBUS ? s_prev_bus_action : s_prev_segv_action;
+            if ((prev.sa_flags & SA_SIGINFO) != 0 && prev.sa_sigaction != nullptr)
+                prev.sa_sigaction(sig, info, context);
+            else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN)
+                prev.sa_handler(sig);
+            else
+                signal(sig, SIG_DFL);
+        }
+
+        bool set_write_fault_handler(write_fault_fn fn)
+        {
+            s_write_fault_fn.store(fn, std::memory_order_release);
+            if (fn == nullptr || s_write_fault_installed.exchange(true))
+                return true;
+
+            // a store to a write-protected page raises SIGSEGV on Linux and SIGBUS on MacOS
+            struct sigaction action = {};
+            action.sa_sigaction     = _posix_fault_handler;
+            action.sa_flags         = SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            const bool ok = sigaction(SIGSEGV, &action, &s_prev_segv_action) == 0 && sigaction(SIGBUS, &action, &s_prev_bus_action) == 0;
+            return check(!ok, ErrorVirtualProtectFailed);
+        }
+#else
+        static LONG CALLBACK _win32_fault_handler(PEXCEPTION_POINTERS info)
+        {
+            EXCEPTION_RECORD const* record = info->ExceptionRecord;
+            if (record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION && record->NumberParameters >= 2 && record->ExceptionInformation[0] == 1)
+            {
+                const write_fault_fn fn = s_write_fault_fn.load(std::memory_order_acquire);
+                if (fn != nullptr && fn((void*)record->ExceptionInformation[1]))
+                    return EXCEPTION_CONTINUE_EXECUTION;
+            }
+            return EXCEPTION_CONTINUE_SEARCH;
+        }
+
+        bool set_write_fault_handler(write_fault_fn fn)
+        {
+            s_write_fault_fn.store(fn, std::memory_order_release);
+            if (fn == nullptr || s_write_fault_installed.exchange(true))
+                return true;
+            return check(AddVectoredExceptionHandler(1, _win32_fault_handler) == NULL, ErrorVirtualProtectFailed);
+        }
+#endif
+
+        bool reserve(u64 address_range, nprotect::value_t attributes, s8 page_size_shift, numa_t const& numa, void*& baseptr, npage::value_t& page_kind)
+        {
+            if (!reserve(address_range, attributes, page_size_shift, baseptr, page_kind))
+                return false;
+            if (numa.policy == nnuma::Default)
+                return true;
+
+            // the range was rounded up to the page size by reserve
+            const u64 system_page_size = (u64)query_page_size();
+            const u64 page_size        = page_size_shift > 0 && ((u64)1 << page_size_shift) > system_page_size ? ((u64)1 << page_size_shift) : system_page_size;
+            address_range              = (address_range + (page_size - 1)) & ~(page_size - 1);
+            if (!numa_apply(baseptr, address_range, numa))
+            {
+                release(baseptr, address_range);
+                baseptr = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+        bool commit(void* page_address, u64 size, numa_t const& numa) { return numa_apply(page_address, size, numa) && commit(page_address, size); }
+
         bool reserve(u64 address_range, nprotect::value_t attributes, void*& baseptr)
         {
             baseptr = alloc_protect(address_range, attributes);
@@ -452,11 +1095,120 @@ namespace ncore
         bool release(void* baseptr, u64 address_range) { return dealloc(baseptr, address_range) == true; }
         bool commit(void* page_address, u64 size) { return commit_protect(page_address, size, nprotect::ReadWrite) == true; }
 
+        enum
+        {
+            cMaxPopulateThreads = 16,
+        };
+
+        static const u64 cMinPopulateBytes = 1 * cMB; // below this a thread costs more to create than the page faults it takes over
+
+        static u32 s_populate_threads   = 4;
+        static u64 s_populate_min_bytes = 16 * cMB;
+
+        void set_populate_threads(u32 max_threads, u64 min_bytes_per_thread)
+        {
+            s_populate_threads   = max_threads < 1 ? 1 : (max_threads > cMaxPopulateThreads ? (u32)cMaxPopulateThreads : max_threads);
+            s_populate_min_bytes = min_bytes_per_thread < cMinPopulateBytes ? cMinPopulateBytes : min_bytes_per_thread;
+        }
+
+        static bool _populate_range(u8* ptr, u64 size)
+        {
+#if defined(VMEM_PLATFORM_LINUX) && defined(MADV_POPULATE_WRITE)
+            // Linux 5.14+, older kernels fail with EINVAL
+            if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+                return true;
+            if (errno != EINVAL)
+                return false;
+#endif
+            // A write access is needed to get a private page, write back the byte that is there to keep the content
+            const u64 page_size = s_page_size != 0 ? s_page_size : query_page_size();
+            for (u64 offset = 0; offset < size; offset += page_size)
+            {
+                volatile u8* p = ptr + offset;
+                *p             = *p;
+            }
+            return true;
+        }
+
+        bool populate(void* address, u64 size)
+        {
+            if (!check(address == 0, ErrorPtrCannotBeNull))
+                return false;
+            if (!check(size == 0, ErrorSizeCannotBe0))
+                return false;
+
+            // Small ranges are populated on the calling thread, threads are only created for ranges of at least
+            // 2 * s_populate_min_bytes
+            u64 num_threads = size / s_populate_min_bytes;
+            num_threads     = num_threads < s_populate_threads ? num_threads : s_populate_threads;
+            if (num_threads <= 1)
+                return _populate_range((u8*)address, size);
+
+            // Split on page boundaries, the calling thread does the last chunk
+            const u64 page_size = s_page_size != 0 ? s_page_size : query_page_size();
+            const u64 chunk     = ((size / num_threads) + (page_size - 1)) & ~(page_size - 1);
+
+            std::thread       workers[cMaxPopulateThreads];
+            std::atomic<bool> ok(true);
+            u8*               ptr = (u8*)address;
+            u64               i   = 0;
+            for (; i < num_threads - 1 && (i + 1) * chunk < size; ++i)
+                workers[i] = std::thread([&ok, ptr, chunk, i]() {
+                    if (!_populate_range(ptr + i * chunk, chunk))
+                        ok.store(false, std::memory_order_relaxed);
+                });
+            bool result = _populate_range(ptr + i * chunk, size - i * chunk);
+            for (u64 j = 0; j < i; ++j)
+                workers[j].join();
+            return result && ok.load(std::memory_order_relaxed);
+        }
+
+        bool commit_populate(void* page_address, u64 size) { return commit(page_address, size) && populate(page_address, size); }
+        bool commit(void* page_address, u64 size, ncommit::value_t mode) { return mode == ncommit::Populate ? commit_populate(page_address, size) : commit(page_address, size); }
+
+#if defined(VMEM_PLATFORM_WIN32)
+        u64 query_time_ns(void)
+        {
+            static LARGE_INTEGER s_frequency = {0};
+            if (s_frequency.QuadPart == 0)
+                QueryPerformanceFrequency(&s_frequency);
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            return (u64)((counter.QuadPart / s_frequency.QuadPart) * 1000000000) + (u64)(((counter.QuadPart % s_frequency.QuadPart) * 1000000000) / s_frequency.QuadPart);
+        }
+#else
+        u64 query_time_ns(void)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+        }
+#endif
+
+        bool commit(void* page_address, u64 size, stats_t& stats)
+        {
+            const u64  start  = query_time_ns();
+            const bool result = commit(page_address, size);
+            stats.commit_time_ns += query_time_ns() - start;
+            stats.commit_count += 1;
+            return result;
+        }
+
+        bool decommit(void* page_address, u64 size, stats_t& stats)
+        {
+            const u64  start  = query_time_ns();
+            const bool result = decommit(page_address, size);
+            stats.decommit_time_ns += query_time_ns() - start;
+            stats.decommit_count += 1;
+            return result;
+        }
+
         bool initialize()
         {
             if (s_page_size == 0)
             {
                 s_page_size              = query_page_size();
+                s_page_size_shift        = math::g_ilog2(s_page_size);
                 s_allocation_granularity = query_allocation_granularity();
             }
             return s_page_size > 0;
@@ -0,0 +1,426 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_pool_concurrent.h"
+#include "cvmem/c_virtual_reclaim.h"
+
+#include <atomic>
+#include <new>
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        // 256 bytes, `Next` links the magazine into one of the depot stacks.
+        struct cpool_magazine_t
+        {
+            u32              Count;
+            std::atomic<u32> Next;
+            u32              Items[cpool_core_t::cMagazineSize];
+        };
+
+        // Lock-free stack of magazines, the head is tagged (magazine index + 1 in the low 32 bits, tag in the high 32 bits)
+        // so that a magazine that is popped and pushed again in between does not corrupt the stack (ABA).
+        struct cpool_depot_t
+        {
+            alignas(64) std::atomic<u64> Head;
+        };
+
+        struct cpool_state_t
+        {
+            alignas(64) std::atomic<u64> FreeIndex; // index of the first never used item
+            alignas(64) std::atomic<u32> PageCount; // number of item pages that are commited
+            alignas(64) std::atomic<u32> MagCount;  // number of magazines that have been created
+            std::atomic<u32> MagPageCount;          // number of magazine storage pages that are commited
+            cpool_depot_t    DepotFull;             // magazines holding one or more free items
+            cpool_depot_t    DepotEmpty;            // magazines holding no items
+
+            cpool_magazine_t* Magazines;  // magazine storage, directly follows this state in the same reservation
+            u64               StateRange; // size of the reservation holding this state and the magazines
+            u32               MagMax;     // maximum number of magazines
+            u32               ItemMax;    // maximum number of items
+            u32               PageMax;    // number of item pages that are reserved
+            u32               PageGrow;   // minimum number of item pages to commit when growing
+            u32               Id;         // unique id of this pool, never reused
+            u32               Slot;       // index in the registry of live pools
+            s8                PageSizeShift;    // page size shift of the item pages
+            s8                MagPageSizeShift; // page size shift of the state and magazine storage (system page size)
+        };
+
+        // Registry of live pools, a thread cache entry is only valid when the pool id in the slot still matches.
+        static std::atomic<u32>            s_cpool_ids[cpool_core_t::cMaxPools];
+        static std::atomic<cpool_state_t*> s_cpool_states[cpool_core_t::cMaxPools];
+        static std::atomic<u32>            s_cpool_id_counter(0);
+
+        static inline cpool_magazine_t* cpool_magazine(cpool_state_t* state, u32 mag) { return mag != 0 ? &state->Magazines[mag - 1] : nullptr; }
+
+        static void cpool_depot_push(cpool_state_t* state, cpool_depot_t& depot, u32 mag)
+        {
+            cpool_magazine_t* magazine = cpool_magazine(state, mag);
+            u64               head     = depot.Head.load(std::memory_order_relaxed);
+            do
+            {
+                magazine->Next.store((u32)head, std::memory_order_relaxed);
+            } while (!depot.Head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | mag, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        static u32 cpool_depot_pop(cpool_state_t* state, cpool_depot_t& depot)
+        {
+            u64 head = depot.Head.load(std::memory_order_acquire);
+            while ((u32)head != 0)
+            {
+                u32 const next = cpool_magazine(state, (u32)head)->Next.load(std::memory_order_relaxed);
+                if (depot.Head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | next, std::memory_order_acquire, std::memory_order_acquire))
+                    return (u32)head;
+            }
+            return 0;
+        }
+
+        // Make sure the pages in [0, page_count) of a range are commited. Commit is idempotent, so threads racing on the
+        // same pages is harmless, the watermark only moves forward after the pages are commited.
+        static bool cpool_commit_to(std::atomic<u32>& watermark, u8* base, s8 page_size_shift, u32 page_count, u32 page_grow, u32 page_max)
+        {
+            u32 committed = watermark.load(std::memory_order_acquire);
+            if (page_count <= committed)
+                return true;
+            if (page_count > page_max)
+                return false;
+
+            u32 target = committed + page_grow;
+            target     = target < page_count ? page_count : target;
+            target     = target > page_max ? page_max : target;
+            if (!nvmem::commit(base + ((u64)committed << page_size_shift), (u64)(target - committed) << page_size_shift))
+                return false;
+
+            while (committed < target && !watermark.compare_exchange_weak(committed, target, std::memory_order_release, std::memory_order_acquire))
+            {
+            }
+            return true;
+        }
+
+        static u32 cpool_new_magazine(cpool_state_t* state)
+        {
+            u32 const mag = state->MagCount.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (mag > state->MagMax)
+            {
+                ASSERTS(false, "concurrent pool: too many threads, ran out of magazines");
+                return 0;
+            }
+
+            u8* const storage_end = (u8*)&state->Magazines[mag];
+            u32 const page_count  = (u32)((storage_end - (u8*)state + ((u64)1 << state->MagPageSizeShift) - 1) >> state->MagPageSizeShift);
+            u32 const page_max    = (u32)(state->StateRange >> state->MagPageSizeShift);
+            if (!cpool_commit_to(state->MagPageCount, (u8*)state, state->MagPageSizeShift, page_count, 1, page_max))
+                return 0;
+
+            cpool_magazine_t* magazine = cpool_magazine(state, mag);
+            magazine->Count            = 0;
+            return mag;
+        }
+
+        static u32 cpool_refill(cpool_state_t* state, u8* baseptr, u32 item_sizeof, cpool_magazine_t* magazine)
+        {
+            u64 const index = state->FreeIndex.fetch_add(cpool_core_t::cMagazineSize, std::memory_order_relaxed);
+            if (index >= state->ItemMax)
+                return 0;
+
+            u32 const count      = (state->ItemMax - index) < cpool_core_t::cMagazineSize ? (u32)(state->ItemMax - index) : (u32)cpool_core_t::cMagazineSize;
+            u64 const end        = index + count;
+            u32 const page_count = (u32)(((end * item_sizeof) + (((u64)1 << state->PageSizeShift) - 1)) >> state->PageSizeShift);
+            if (!cpool_commit_to(state->PageCount, baseptr, state->PageSizeShift, page_count, state->PageGrow, state->PageMax))
+                return 0;
+
+            // reversed, so that items are handed out in ascending order
+            for (u32 i = 0; i < count; ++i)
+                magazine->Items[i] = (u32)(end - 1 - i);
+            magazine->Count = count;
+            return count;
+        }
+
+        // Per thread cache, one entry per registry slot, magazines are stored as index + 1 (0 = none).
+        struct cpool_tcache_entry_t
+        {
+            u32 PoolId;
+            u32 Loaded;
+            u32 Previous;
+        };
+
+        static void cpool_flush(cpool_state_t* state, cpool_tcache_entry_t& entry)
+        {
+            u32 const mags[2] = {entry.Loaded, entry.Previous};
+            for (u32 i = 0; i < 2; ++i)
+            {
+                if (mags[i] == 0)
+                    continue;
+                if (cpool_magazine(state, mags[i])->Count > 0)
+                    cpool_depot_push(state, state->DepotFull, mags[i]);
+                else
+                    cpool_depot_push(state, state->DepotEmpty, mags[i]);
+            }
+            entry.Loaded   = 0;
+            entry.Previous = 0;
+        }
+
+        struct cpool_tcache_t
+        {
+            cpool_tcache_entry_t Entries[cpool_core_t::cMaxPools];
+
+            ~cpool_tcache_t()
+            {
+                for (u32 slot = 0; slot < cpool_core_t::cMaxPools; ++slot)
+                {
+                    cpool_tcache_entry_t& entry = Entries[slot];
+                    if (entry.PoolId == 0 || s_cpool_ids[slot].load(std::memory_order_acquire) != entry.PoolId)
+                        continue;
+                    cpool_flush(s_cpool_states[slot].load(std::memory_order_acquire), entry);
+                }
+            }
+        };
+
+        static thread_local cpool_tcache_t s_cpool_tcache;
+
+        static inline cpool_tcache_entry_t& cpool_tcache_entry(cpool_state_t* state)
+        {
+            cpool_tcache_entry_t& entry = s_cpool_tcache.Entries[state->Slot];
+            if (entry.PoolId != state->Id)
+            {
+                // stale entry of a pool that used this slot before, its magazines died with that pool
+                entry.PoolId   = state->Id;
+                entry.Loaded   = 0;
+                entry.Previous = 0;
+            }
+            return entry;
+        }
+
+        cpool_core_t::cpool_core_t()
+            : m_baseptr(nullptr)
+            , m_item_sizeof(0)
+            , m_state(nullptr)
+        {
+        }
+
+        bool cpool_core_t::setup(u32 item_sizeof, u32 initial_item_count, u32 maximum_item_count, s8 page_size_shift)
+        {
+            if (m_state != nullptr || maximum_item_count == 0)
+                return false;
+
+            nvmem::initialize();
+            const s8 system_page_size_shift = nvmem::get_page_size_shift();
+            page_size_shift                 = page_size_shift < system_page_size_shift ? system_page_size_shift : (page_size_shift > 30 ? 30 : page_size_shift);
+            item_sizeof                     = item_sizeof == 0 ? 1 : item_sizeof;
+
+            // Shared state and magazine storage, one reservation with system page size, commited on demand.
+            // Magazines in existence are bounded by the full ones plus the two that each thread holds.
+            const u64 system_page_size = (u64)1 << system_page_size_shift;
+            const u32 mag_max          = ((maximum_item_count + cMagazineSize - 1) / cMagazineSize) + 2 * cMaxThreads + 1;
+            const u64 state_bytes      = (sizeof(cpool_state_t) + 63) & ~(u64)63;
+            const u64 state_range      = (state_bytes + (u64)mag_max * sizeof(cpool_magazine_t) + system_page_size - 1) & ~(system_page_size - 1);
+            void*     state_mem        = nullptr;
+            if (!nvmem::reserve(state_range, nvmem::nprotect::ReadWrite, state_mem))
+                return false;
+            if (!nvmem::commit(state_mem, (state_bytes + system_page_size - 1) & ~(system_page_size - 1)))
+            {
+                nvmem::release(state_mem, state_range);
+                return false;
+            }
+
+            const u32             page_max = (u32)((((u64)maximum_item_count * item_sizeof) + (((u64)1 << page_size_shift) - 1)) >> page_size_shift);
+            void*                 baseptr  = nullptr;
+            nvmem::npage::value_t page_kind;
+            if (!nvmem::reserve((u64)page_max << page_size_shift, nvmem::nprotect::ReadWrite, page_size_shift, baseptr, page_kind))
+            {
+                nvmem::release(state_mem, state_range);
+                return false;
+            }
+
+            cpool_state_t* state = new (state_mem) cpool_state_t();
+            state->FreeIndex.store(0, std::memory_order_relaxed);
+            state->PageCount.store(0, std::memory_order_relaxed);
+            state->MagCount.store(0, std::memory_order_relaxed);
+            state->MagPageCount.store((u32)(((state_bytes + system_page_size - 1) & ~(system_page_size - 1)) >> system_page_size_shift), std::memory_order_relaxed);
+            state->DepotFull.Head.store(0, std::memory_order_relaxed);
+            state->DepotEmpty.Head.store(0, std::memory_order_relaxed);
+            state->Magazines     = (cpool_magazine_t*)((u8*)state_mem + state_bytes);
+            state->StateRange    = state_range;
+            state->MagMax        = mag_max;
+            state->ItemMax       = maximum_item_count;
+            state->PageMax          = page_max;
+            state->PageSizeShift    = page_size_shift;
+            state->MagPageSizeShift = system_page_size_shift;
+
+            const u32 page_init = (u32)((((u64)initial_item_count * item_sizeof) + (((u64)1 << page_size_shift) - 1)) >> page_size_shift);
+            state->PageGrow     = page_init > 0 ? page_init : 1;
+
+            m_baseptr     = (u8*)baseptr;
+            m_item_sizeof = item_sizeof;
+
+            bool ok = true;
+            if (page_init > 0)
+                ok = cpool_commit_to(state->PageCount, m_baseptr, page_size_shift, page_init > page_max ? page_max : page_init, 1, page_max);
+
+            // register in a free slot
+            u32 slot = cMaxPools;
+            if (ok)
+            {
+                state->Id = s_cpool_id_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+                for (slot = 0; slot < cMaxPools; ++slot)
+                {
+                    u32 free_id = 0;
+                    if (s_cpool_ids[slot].load(std::memory_order_relaxed) == 0 && s_cpool_ids[slot].compare_exchange_strong(free_id, state->Id, std::memory_order_acq_rel))
+                        break;
+                }
+            }
+
+            if (slot == cMaxPools)
+            {
+                ASSERTS(!ok, "concurrent pool: too many live pools");
+                nvmem::release(m_baseptr, (u64)page_max << page_size_shift);
+                nvmem::release(state_mem, state_range);
+                m_baseptr = nullptr;
+                return false;
+            }
+
+            state->Slot = slot;
+            s_cpool_states[slot].store(state, std::memory_order_release);
+            m_state = state;
+            return true;
+        }
+
+        bool cpool_core_t::teardown()
+        {
+            if (m_state == nullptr)
+                return true;
+
+            cpool_state_t* state = m_state;
+            s_cpool_ids[state->Slot].store(0, std::memory_order_release);
+            s_cpool_states[state->Slot].store(nullptr, std::memory_order_release);
+
+            // the calling thread forgets its magazines, other threads detect their cache entry is stale via the pool id
+            cpool_tcache_entry_t& entry = s_cpool_tcache.Entries[state->Slot];
+            if (entry.PoolId == state->Id)
+            {
+                entry.PoolId   = 0;
+                entry.Loaded   = 0;
+                entry.Previous = 0;
+            }
+
+            const u64 item_range  = (u64)state->PageMax << state->PageSizeShift;
+            const u64 state_range = state->StateRange;
+            m_state               = nullptr;
+
+            bool ok = true;
+            if (nvmem::reclaim_running())
+            {
+                nvmem::release_async(m_baseptr, item_range);
+                nvmem::release_async(state, state_range);
+            }
+            else
+            {
+                ok = nvmem::release(m_baseptr, item_range);
+                ok = nvmem::release(state, state_range) && ok;
+            }
+
+            m_baseptr     = nullptr;
+            m_item_sizeof = 0;
+            return ok;
+        }
+
+        u32 cpool_core_t::allocate()
+        {
+            cpool_state_t* const  state    = m_state;
+            cpool_tcache_entry_t& entry    = cpool_tcache_entry(state);
+            cpool_magazine_t*     magazine = cpool_magazine(state, entry.Loaded);
+            if (magazine != nullptr && magazine->Count > 0)
+                return magazine->Items[--magazine->Count];
+
+            cpool_magazine_t* previous = cpool_magazine(state, entry.Previous);
+            if (previous != nullptr && previous->Count > 0)
+            {
+                entry.Previous = entry.Loaded;
+                entry.Loaded   = (u32)(previous - state->Magazines) + 1;
+                return previous->Items[--previous->Count];
+            }
+
+            // both magazines are empty, exchange one for a full magazine from the depot
+            u32 const full = cpool_depot_pop(state, state->DepotFull);
+            if (full != 0)
+            {
+                if (entry.Previous != 0)
+                    cpool_depot_push(state, state->DepotEmpty, entry.Previous);
+                entry.Previous = entry.Loaded;
+                entry.Loaded   = full;
+                magazine       = cpool_magazine(state, full);
+                return magazine->Items[--magazine->Count];
+            }
+
+            // the depot has no free items, refill a whole magazine from the never used part of the pool
+            if (magazine == nullptr)
+            {
+                entry.Loaded = cpool_depot_pop(state, state->DepotEmpty);
+                if (entry.Loaded == 0)
+                    entry.Loaded = cpool_new_magazine(state);
+                magazine = cpool_magazine(state, entry.Loaded);
+                if (magazine == nullptr)
+                    return cInvalidIndex;
+            }
+            if (cpool_refill(state, m_baseptr, m_item_sizeof, magazine) == 0)
+                return cInvalidIndex;
+            return magazine->Items[--magazine->Count];
+        }
+
+        void cpool_core_t::deallocate(u32 index)
+        {
+            cpool_state_t* const  state    = m_state;
+            cpool_tcache_entry_t& entry    = cpool_tcache_entry(state);
+            cpool_magazine_t*     magazine = cpool_magazine(state, entry.Loaded);
+            if (magazine != nullptr && magazine->Count < cMagazineSize)
+            {
+                magazine->Items[magazine->Count++] = index;
+                return;
+            }
+
+            cpool_magazine_t* previous = cpool_magazine(state, entry.Previous);
+            if (previous != nullptr && previous->Count < cMagazineSize)
+            {
+                entry.Previous                     = entry.Loaded;
+                entry.Loaded                       = (u32)(previous - state->Magazines) + 1;
+                previous->Items[previous->Count++] = index;
+                return;
+            }
+
+            // both magazines are full (or missing), hand the previous one to the depot and continue with an empty one
+            if (entry.Previous != 0)
+                cpool_depot_push(state, state->DepotFull, entry.Previous);
+            entry.Previous = entry.Loaded;
+
+            u32 empty = cpool_depot_pop(state, state->DepotEmpty);
+            if (empty == 0)
+                empty = cpool_new_magazine(state);
+            entry.Loaded = empty;
+
+            magazine = cpool_magazine(state, empty);
+            if (magazine == nullptr)
+                return; // out of magazines, the item is lost
+            magazine->Items[magazine->Count++] = index;
+        }
+
+        void cpool_core_t::flush()
+        {
+            if (m_state == nullptr)
+                return;
+            cpool_flush(m_state, cpool_tcache_entry(m_state));
+        }
+
+        u32 cpool_core_t::capacity() const
+        {
+            if (m_state == nullptr)
+                return 0;
+            const u64 items = ((u64)m_state->PageCount.load(std::memory_order_relaxed) << m_state->PageSizeShift) / m_item_sizeof;
+            return items < m_state->ItemMax ? (u32)items : m_state->ItemMax;
+        }
+
+        u32 cpool_core_t::max_capacity() const { return m_state != nullptr ? m_state->ItemMax : 0; }
+
+    } // namespace nvmem
+} // namespace ncore
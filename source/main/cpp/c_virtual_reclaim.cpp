@@ -0,0 +1,286 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_reclaim.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        enum
+        {
+            cReclaimDecommit = 0,
+            cReclaimRelease  = 1,
+            cReclaimMaxBatch = 256,
+        };
+
+        struct reclaim_item_t
+        {
+            u8*        Address;
+            u64        Size;
+            reclaim_fn Done;
+            void*      User;
+            u32        Kind; // cReclaimDecommit or cReclaimRelease
+        };
+
+        // Requests live in a ring buffer, request `ticket` is at (ticket - 1) % Capacity. Tickets are handed out in order
+        // and the reclaimer completes them in order, so `Completed` is the ticket of the last request that is done.
+        // Tickets keep counting over a stop and start, a ticket of an earlier run is always done.
+        struct reclaim_queue_t
+        {
+            std::mutex              Mutex;
+            std::condition_variable Work;  // signaled when requests are queued or the reclaimer has to stop
+            std::condition_variable Space; // signaled when the reclaimer took requests from the queue
+            std::condition_variable Done;  // signaled when the reclaimer completed a batch
+            std::thread             Thread;
+            reclaim_item_t*         Items;
+            u64                     ItemsRange;
+            u32                     Capacity;
+            u32                     BatchSize;
+            u64                     Enqueued; // ticket of the last queued request
+            u64                     Dequeued; // ticket of the last request taken by the reclaimer
+            std::atomic<u64>        Completed;
+            std::atomic<bool>       Running;
+            bool                    Stop;
+            reclaim_stats_t         Stats;
+
+            reclaim_queue_t()
+                : Items(nullptr)
+                , ItemsRange(0)
+                , Capacity(0)
+                , BatchSize(0)
+                , Enqueued(0)
+                , Dequeued(0)
+                , Completed(0)
+                , Running(false)
+                , Stop(false)
+            {
+                Stats = {0, 0, 0, 0, 0, 0, 0};
+            }
+
+            ~reclaim_queue_t() { reclaim_stop(); }
+        };
+
+        static reclaim_queue_t s_reclaim;
+
+        static void reclaim_thread()
+        {
+            reclaim_queue_t& q = s_reclaim;
+            reclaim_item_t   batch[cReclaimMaxBatch];
+            for (;;)
+            {
+                u64 first, count;
+                {
+                    std::unique_lock<std::mutex> lock(q.Mutex);
+                    q.Work.wait(lock, [&q]() { return q.Stop || q.Dequeued < q.Enqueued; });
+                    if (q.Dequeued == q.Enqueued)
+                        break; // stopping and nothing left to do
+
+                    first = q.Dequeued + 1;
+                    count = q.Enqueued - q.Dequeued;
+                    count = count < q.BatchSize ? count : q.BatchSize;
+                    for (u64 i = 0; i < count; ++i)
+                        batch[i] = q.Items[(first - 1 + i) % q.Capacity];
+                    q.Dequeued += count;
+                }
+                q.Space.notify_all();
+
+                // Decommits of adjacent ranges are merged into one call, in either order, e.g. an arena shrinking in
+                // steps hands out ranges that each end where the previous one starts
+                u64 failures = 0, decommit_bytes = 0, release_bytes = 0;
+                for (u64 i = 0; i < count; ++i)
+                {
+                    reclaim_item_t const& item = batch[i];
+                    if (item.Kind == cReclaimRelease)
+                    {
+                        failures += release(item.Address, item.Size) ? 0 : 1;
+                        release_bytes += item.Size;
+                        if (item.Done != nullptr)
+                            item.Done(item.User);
+                        continue;
+                    }
+
+                    u8* address = item.Address;
+                    u64 merged  = item.Size;
+                    while ((i + 1) < count && batch[i + 1].Kind == cReclaimDecommit)
+                    {
+                        reclaim_item_t const& next = batch[i + 1];
+                        if (next.Address == address + merged)
+                            merged += next.Size;
+                        else if (next.Address + next.Size == address)
+                        {
+                            address = next.Address;
+                            merged += next.Size;
+                        }
+                        else
+                            break;
+                        ++i;
+                    }
+                    failures += decommit(address, merged) ? 0 : 1;
+                    decommit_bytes += merged;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(q.Mutex);
+                    q.Completed.store(first + count - 1, std::memory_order_release);
+                    q.Stats.completed += count;
+                    q.Stats.batches += 1;
+                    q.Stats.failures += failures;
+                    q.Stats.decommit_bytes += decommit_bytes;
+                    q.Stats.release_bytes += release_bytes;
+                }
+                q.Done.notify_all();
+            }
+        }
+
+        bool reclaim_start(u32 queue_capacity, u32 batch_size)
+        {
+            reclaim_queue_t& q = s_reclaim;
+            if (q.Running.load(std::memory_order_acquire))
+                return true;
+
+            nvmem::initialize();
+            queue_capacity        = queue_capacity < 16 ? 16 : queue_capacity;
+            const u64 page_size   = get_page_size();
+            const u64 items_range = ((u64)queue_capacity * sizeof(reclaim_item_t) + page_size - 1) & ~(page_size - 1);
+            void*     items       = nullptr;
+            if (!reserve(items_range, nprotect::ReadWrite, items))
+                return false;
+            if (!commit(items, items_range))
+            {
+                release(items, items_range);
+                return false;
+            }
+
+            q.Items      = (reclaim_item_t*)items;
+            q.ItemsRange = items_range;
+            q.Capacity   = (u32)(items_range / sizeof(reclaim_item_t));
+            q.BatchSize  = batch_size < 1 ? 1 : (batch_size > cReclaimMaxBatch ? (u32)cReclaimMaxBatch : batch_size);
+            q.Stop       = false;
+            q.Thread     = std::thread(reclaim_thread);
+            q.Running.store(true, std::memory_order_release);
+            return true;
+        }
+
+        void reclaim_stop()
+        {
+            reclaim_queue_t& q = s_reclaim;
+            if (!q.Running.load(std::memory_order_acquire))
+                return;
+
+            {
+                std::unique_lock<std::mutex> lock(q.Mutex);
+                q.Stop = true;
+            }
+            q.Work.notify_all();
+            q.Thread.join();
+            q.Running.store(false, std::memory_order_release);
+
+            release(q.Items, q.ItemsRange);
+            q.Items      = nullptr;
+            q.ItemsRange = 0;
+            q.Capacity   = 0;
+        }
+
+        bool reclaim_running() { return s_reclaim.Running.load(std::memory_order_acquire); }
+
+        static u64 reclaim_push(u8* address, u64 size, u32 kind, reclaim_fn done, void* user)
+        {
+            reclaim_queue_t& q      = s_reclaim;
+            u64              ticket = 0;
+            {
+                std::unique_lock<std::mutex> lock(q.Mutex);
+                if ((q.Enqueued - q.Dequeued) >= q.Capacity)
+                {
+                    q.Stats.stalls += 1;
+                    q.Space.wait(lock, [&q]() { return (q.Enqueued - q.Dequeued) < q.Capacity; });
+                }
+
+                ticket               = ++q.Enqueued;
+                reclaim_item_t& item = q.Items[(ticket - 1) % q.Capacity];
+                item.Address         = address;
+                item.Size            = size;
+                item.Done            = done;
+                item.User            = user;
+                item.Kind            = kind;
+                q.Stats.queued += 1;
+            }
+            q.Work.notify_one();
+            return ticket;
+        }
+
+        u64 decommit_async(void* address, u64 size)
+        {
+            if (!reclaim_running())
+            {
+                decommit(address, size);
+                return 0;
+            }
+            return reclaim_push((u8*)address, size, cReclaimDecommit, nullptr, nullptr);
+        }
+
+        u64 decommit_async(void* address, u64 size, stats_t& stats)
+        {
+            if (!reclaim_running())
+            {
+                decommit(address, size, stats);
+                return 0;
+            }
+            const u64 start  = query_time_ns();
+            const u64 ticket = reclaim_push((u8*)address, size, cReclaimDecommit, nullptr, nullptr);
+            stats.decommit_time_ns += query_time_ns() - start;
+            stats.decommit_count += 1;
+            return ticket;
+        }
+
+        u64 release_async(void* baseptr, u64 address_range, reclaim_fn done, void* user)
+        {
+            if (!reclaim_running())
+            {
+                release(baseptr, address_range);
+                if (done != nullptr)
+                    done(user);
+                return 0;
+            }
+            return reclaim_push((u8*)baseptr, address_range, cReclaimRelease, done, user);
+        }
+
+        bool reclaim_done(u64 ticket) { return ticket <= s_reclaim.Completed.load(std::memory_order_acquire); }
+
+        void reclaim_wait(u64 ticket)
+        {
+            reclaim_queue_t& q = s_reclaim;
+            if (reclaim_done(ticket))
+                return;
+            std::unique_lock<std::mutex> lock(q.Mutex);
+            q.Done.wait(lock, [&q, ticket]() { return ticket <= q.Completed.load(std::memory_order_relaxed); });
+        }
+
+        void reclaim_flush()
+        {
+            reclaim_queue_t& q = s_reclaim;
+            if (!reclaim_running())
+                return;
+            u64 ticket;
+            {
+                std::unique_lock<std::mutex> lock(q.Mutex);
+                ticket = q.Enqueued;
+            }
+            reclaim_wait(ticket);
+        }
+
+        void reclaim_get_stats(reclaim_stats_t& stats)
+        {
+            reclaim_queue_t&             q = s_reclaim;
+            std::unique_lock<std::mutex> lock(q.Mutex);
+            stats = q.Stats;
+        }
+
+    } // namespace nvmem
+} // namespace ncore
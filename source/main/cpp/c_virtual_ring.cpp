@@ -0,0 +1,103 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_ring.h"
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        ring_t::ring_t()
+            : m_baseptr(nullptr)
+            , m_capacity(0)
+            , m_mask(0)
+            , m_write(0)
+            , m_read_seen(0)
+            , m_read(0)
+            , m_write_seen(0)
+        {
+        }
+
+        bool ring_t::setup(u32 capacity)
+        {
+            if (m_baseptr != nullptr || capacity == 0 || capacity > 0x80000000u)
+                return false;
+
+            // The mirrored views are mapped at the allocation granularity, initialize() caches it
+            initialize();
+            u64 size = get_allocation_granularity();
+            if (size == 0)
+                return false;
+            while (size < capacity)
+                size <<= 1;
+
+            void* baseptr = nullptr;
+            if (!mirror_alloc(size, baseptr))
+                return false;
+
+            m_baseptr    = (u8*)baseptr;
+            m_capacity   = (u32)size;
+            m_mask       = m_capacity - 1;
+            m_write.store(0, std::memory_order_relaxed);
+            m_read_seen = 0;
+            m_read.store(0, std::memory_order_relaxed);
+            m_write_seen = 0;
+            return true;
+        }
+
+        bool ring_t::teardown()
+        {
+            if (m_baseptr == nullptr)
+                return true;
+            const bool ok = mirror_release(m_baseptr, m_capacity);
+            m_baseptr     = nullptr;
+            m_capacity    = 0;
+            m_mask        = 0;
+            return ok;
+        }
+
+        u8* ring_t::write_begin(u32 size)
+        {
+            // only the producer stores m_write, a relaxed load of it is enough
+            const u64 write = m_write.load(std::memory_order_relaxed);
+            if ((write - m_read_seen) + size > m_capacity)
+            {
+                m_read_seen = m_read.load(std::memory_order_acquire);
+                if ((write - m_read_seen) + size > m_capacity)
+                    return nullptr;
+            }
+            return m_baseptr + (write & m_mask);
+        }
+
+        void ring_t::write_end(u32 size)
+        {
+            const u64 write = m_write.load(std::memory_order_relaxed);
+            ASSERT((write - m_read_seen) + size <= m_capacity);
+            m_write.store(write + size, std::memory_order_release);
+        }
+
+        u8 const* ring_t::read_begin(u32& size)
+        {
+            const u64 read = m_read.load(std::memory_order_relaxed);
+            m_write_seen   = m_write.load(std::memory_order_acquire);
+            size           = (u32)(m_write_seen - read);
+            return m_baseptr + (read & m_mask);
+        }
+
+        void ring_t::read_end(u32 size)
+        {
+            const u64 read = m_read.load(std::memory_order_relaxed);
+            ASSERT(read + size <= m_write_seen);
+            m_read.store(read + size, std::memory_order_release);
+        }
+
+        u32 ring_t::size() const
+        {
+            // read first, the write position loaded after it is never behind it
+            const u64 read  = m_read.load(std::memory_order_acquire);
+            const u64 write = m_write.load(std::memory_order_acquire);
+            return (u32)(write - read);
+        }
+    } // namespace nvmem
+} // namespace ncore
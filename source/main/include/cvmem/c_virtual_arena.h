@@ -5,34 +5,128 @@
 #    pragma once
 #endif
 
+#include "cvmem/c_virtual_memory.h"
+
 namespace ncore
 {
     // Arena using virtual memory. Works like a resizable array, but doesn't need to be reallocated and copied.
     // Very useful for implementing memory allocators and containers.
     struct arena_t
     {
-        u8*   Mem;              // base address of the memory arena, aligned to page size.
-        int_t Pos;              // current byte position in the arena, this is the next available position to allocate from.
-        s32   CapacityReserved; // (unit=pages) total capacity
-        s32   CapacityCommited; // (unit=pages) total commited
-        s8    PageSizeShift;    // page size shift, used to compute page size as (1 << PageSizeShift) (12-20).
-        s8    AlignmentShift;   // minimum alignment for allocations, must be a power of two (2-16).
-        s8    Dummy[6];         // padding to make the struct a power of two size
+        u8*   Mem;                  // base address of the memory arena, aligned to page size.
+        int_t Pos;                  // current byte position in the arena, this is the next available position to allocate from.
+        s32   CapacityReserved;     // (unit=pages) total capacity
+        s32   CapacityCommited;     // (unit=pages) total commited
+        s8    PageSizeShift;        // page size shift, used to compute page size as (1 << PageSizeShift) (12-30).
+        s8    AlignmentShift;       // minimum alignment for allocations, must be a power of two (2-16).
+        s8    PageKind;             // kind of pages backing the arena (nvmem::npage), Normal, Transparent or Huge.
+        u8    Flags;                // ARENA_FLAG_* given to ArenaAlloc.
+        s32   CapacityCommitedBack; // (unit=pages) commited at the end of the reservation for the back stack (ARENA_FLAG_DOUBLE_ENDED)
     };
 
     enum
     {
         ARENA_DEFAULT_ALIGNMENT_SHIFT = 3, // 8 bytes alignment
-        ARENA_DEFAULT_PAGESIZE_SHIFT  = 12 // 4096 bytes page size
+        ARENA_DEFAULT_PAGESIZE_SHIFT  = 12, // 4096 bytes page size
+        ARENA_HUGE_PAGESIZE_SHIFT     = 21, // 2 MiB huge page size
+        ARENA_GIANT_PAGESIZE_SHIFT    = 30, // 1 GiB huge page size
+        ARENA_SCRATCH_COUNT           = 2,  // number of scratch arenas per thread
+        ARENA_DIRTY_MAX               = 64, // number of arenas that can be dirty tracked at the same time
+    };
+
+    enum
+    {
+        ARENA_FLAG_NONE         = 0,
+        ARENA_FLAG_PREFAULT     = 1, // commited pages are populated right away (nvmem::populate), pushes don't page fault
+        ARENA_FLAG_FILE         = 2, // the arena is backed by a file, set by ArenaAllocFile
+        ARENA_FLAG_GUARD        = 4, // overrun detection with NoAccess pages, see ArenaAlloc
+        ARENA_FLAG_DIRTY        = 8, // the pages that are stored to are tracked, set by ArenaDirtyTrack
+        ARENA_FLAG_DOUBLE_ENDED = 16, // a second stack grows down from the end of the reservation, see ArenaPushBack
     };
 
     // Initialize the arena system, this must be called before any other arena function
     void ArenasSetup(s32 init_num_arenas = 256, s32 max_num_arenas = 8192, s8 default_alignment_shift = ARENA_DEFAULT_ALIGNMENT_SHIFT, s8 default_page_size_shift = ARENA_DEFAULT_PAGESIZE_SHIFT);
     void ArenasTeardown();
 
-    arena_t* ArenaAlloc(int_t reserved_size_in_bytes, int_t commit_size_in_bytes, s8 alignment_shift = ARENA_DEFAULT_ALIGNMENT_SHIFT, s8 page_size_shift = ARENA_DEFAULT_PAGESIZE_SHIFT);
+    // A `page_size_shift` above the system page size (e.g. ARENA_HUGE_PAGESIZE_SHIFT) asks for huge pages, when they are not
+    // available the arena falls back to normal pages but keeps committing in chunks of (1 << page_size_shift).
+    // `arena->PageKind` reports which kind of pages the arena actually got.
+    // With ARENA_FLAG_PREFAULT the initial commit and every growth pay the page faults up front, e.g. at load time.
+    // With ARENA_FLAG_GUARD (or nvmem guard mode, see `nvmem::set_guard_mode`) overruns fault instead of corrupting memory,
+    // pushes are not checked so this costs nothing on the fast path:
+    //   - the reservation is followed by a NoAccess page
+    //   - only the pages in use are commited, the commit size and policy are ignored and popped pages are decommited
+    //     right away, so touching popped memory or memory past the position on a later page faults
+    //   - a push of a page or more is placed so that it ends against a NoAccess page that the position skips
+    //     (ArenaPushConcurrent does not do this)
+    arena_t* ArenaAlloc(int_t reserved_size_in_bytes, int_t commit_size_in_bytes, s8 alignment_shift = ARENA_DEFAULT_ALIGNMENT_SHIFT, s8 page_size_shift = ARENA_DEFAULT_PAGESIZE_SHIFT, u32 flags = ARENA_FLAG_NONE);
+
+    // Same as above, the NUMA policy is applied to the whole reservation before anything is commited.
+    // e.g. ArenaAlloc(1 << 30, 1 << 20, {nvmem::nnuma::Bind, 1 << node}) or {nvmem::nnuma::Interleave, 0} for all nodes.
+    arena_t* ArenaAlloc(int_t reserved_size_in_bytes, int_t commit_size_in_bytes, nvmem::numa_t const& numa, s8 alignment_shift = ARENA_DEFAULT_ALIGNMENT_SHIFT, s8 page_size_shift = ARENA_DEFAULT_PAGESIZE_SHIFT, u32 flags = ARENA_FLAG_NONE);
     void     ArenaRelease(arena_t* arena);
 
+    // File-backed arena, the arena memory is a mapping of a file that grows and shrinks with the commited range, so
+    // the content and the position outlive the process. The first page of the file is a small header (position,
+    // base address and sizes), the arena memory follows it.
+    // An existing file is reopened with its position restored, at the base address it had before when that address
+    // range is free and elsewhere otherwise, see ArenaFileBase. The page size and alignment of an existing file are
+    // kept and the reserved size is the larger of the two.
+    // With a null `path` the arena is backed by an anonymous in-memory file, which does not persist but can be snapshotted.
+    // e.g.
+    //   arena_t* index = ArenaAllocFile("index.bin", (int_t)64 << 30, 64 << 20);
+    //   if (ArenaPos(index) == 0)
+    //       build_index(index);
+    //   else if (index->Mem != ArenaFileBase(index))
+    //       rebase_index(index, index->Mem - ArenaFileBase(index));
+    //   ArenaFlush(index);
+    //   ArenaRelease(index); // unmaps and closes, the file stays
+    // Note: Not supported on Windows (see nvmem::file_map), this returns nullptr there.
+    // Note: ARENA_FLAG_GUARD does not apply to file-backed arenas, the file mapping ends where the file ends.
+    arena_t* ArenaAllocFile(const char* path, int_t reserved_size_in_bytes, int_t commit_size_in_bytes, s8 alignment_shift = ARENA_DEFAULT_ALIGNMENT_SHIFT, s8 page_size_shift = ARENA_DEFAULT_PAGESIZE_SHIFT, u32 flags = ARENA_FLAG_NONE);
+
+    // Write the pages in use and then the position of a file-backed arena to the file and wait until they are stored.
+    // ArenaRelease also records the position but does not wait for the pages to be written.
+    bool ArenaFlush(arena_t* arena);
+
+    // @returns the base address recorded in the file of a file-backed arena, the address of the arena memory when it was
+    // last flushed or released. When this differs from `arena->Mem` pointers stored in the arena need to be relocated.
+    u8* ArenaFileBase(const arena_t* arena);
+
+    // Copy-on-write snapshots of a file-backed arena, e.g. ArenaAllocFile(nullptr, ...) for one that only lives in memory.
+    // ArenaSnapshot maps the arena copy-on-write, the file keeps the content and the position at that point and a page
+    // is copied when it is first stored to. ArenaRestore drops the copied pages and goes back to the snapshot, which
+    // stays and can be restored again. ArenaSnapshotDrop keeps the changes and ends the snapshot.
+    // Taking or restoring a snapshot costs in the order of the pages stored to since the last one, not the arena size.
+    // e.g.
+    //   ArenaSnapshot(arena);
+    //   if (!run_speculative_batch(arena))
+    //       ArenaRestore(arena);
+    //   ArenaSnapshotDrop(arena);
+    // Taking a snapshot while one is taken keeps the changes since the previous one (like ArenaSnapshotDrop).
+    // While a snapshot is taken the file is the snapshot, ArenaFlush stores that and ArenaRelease drops the changes.
+    bool ArenaSnapshot(arena_t* arena);
+    bool ArenaRestore(arena_t* arena);
+    bool ArenaSnapshotDrop(arena_t* arena);
+
+    // Dirty page tracking, e.g. to replicate an arena by only sending the pages that changed since the last sync.
+    // Clean pages are write-protected, the first store to one takes a fault that marks the page dirty and makes it
+    // writable again (see nvmem::set_write_fault_handler), further stores to it run at full speed. While an arena is
+    // tracked it owns the protection of its commited pages, a store to one of them always makes the page writable.
+    // ArenaDirtyTrack starts with all commited pages dirty, pages that are commited later are dirty as well.
+    // ArenaDirtyCheckpoint hands the runs of dirty pages to `fn`, as a byte offset from `arena->Mem` and a size, and
+    // makes them clean, a page stored to while `fn` reads it is reported again by the next checkpoint.
+    // e.g.
+    //   ArenaDirtyTrack(arena);
+    //   ...
+    //   ArenaDirtyCheckpoint(arena, [](const arena_t* a, int_t offset, int_t size, void* user) { send(user, a->Mem + offset, size); }, link);
+    // @returns the number of dirty bytes that were handed to `fn`.
+    // Note: At most ARENA_DIRTY_MAX arenas can be tracked at the same time, arenas with ARENA_FLAG_GUARD can't be tracked.
+    typedef void (*arena_dirty_fn)(const arena_t* arena, int_t offset, int_t size, void* user);
+    bool  ArenaDirtyTrack(arena_t* arena);
+    int_t ArenaDirtyCheckpoint(arena_t* arena, arena_dirty_fn fn, void* user);
+    void  ArenaDirtyUntrack(arena_t* arena);
+
     // Set the name of the arena, this is used for debugging and logging.
     // Note: These name strings need to have a lifetime longer than the arena itself.
     void        ArenaSetName(arena_t* arena, const char* name);
@@ -47,11 +141,40 @@ namespace ncore
     void* ArenaPushAligned(arena_t* arena, int_t size_bytes, s32 alignment);
     void* ArenaPushZeroAligned(arena_t* arena, int_t size_bytes, s32 alignment);
 
+    // Concurrent push, can be called from multiple threads at the same time on the same arena, the position is advanced
+    // with an atomic fetch-add and only one thread at a time grows the commited range while the others wait for it.
+    // The size is rounded up to the minimum alignment of the arena so that every returned pointer is aligned.
+    // Note: Do not mix with the non-concurrent functions (Push, Pop, Clear, Commit) while other threads are pushing.
+    // Note: When the reserved range is exhausted the push fails and the arena stays full until it is popped or cleared.
+    void* ArenaPushConcurrent(arena_t* arena, int_t size_bytes);
+    void* ArenaPushConcurrentAligned(arena_t* arena, int_t size_bytes, s32 alignment);
+
     // Pop releases the last `size_bytes` bytes from the arena.
     void ArenaPopTo(arena_t* arena, int_t position);
     void ArenaPop(arena_t* arena, int_t size_bytes);
 
+    // Double-ended arena (ARENA_FLAG_DOUBLE_ENDED), a back stack grows down from the end of the same reservation, e.g.
+    // for temporaries next to a long-lived result. Each stack commits pages from its own end (the back follows the
+    // policy of the arena as well) and takes over the pages that the other stack has commited but doesn't use.
+    // A push that would make the two positions meet returns nullptr and leaves the arena as it was, the stacks meet
+    // at page granularity. The back position is the number of bytes in use at the back, back pushes are rounded up
+    // to the minimum alignment of the arena.
+    // e.g.
+    //   arena_t*    arena  = ArenaAlloc(64 << 20, 64 << 10, ARENA_DEFAULT_ALIGNMENT_SHIFT, ARENA_DEFAULT_PAGESIZE_SHIFT, ARENA_FLAG_DOUBLE_ENDED);
+    //   result_t*   result = (result_t*)ArenaPush(arena, sizeof(result_t));
+    //   const int_t mark   = ArenaPosBack(arena);
+    //   temp_t*     temp   = (temp_t*)ArenaPushBack(arena, count * sizeof(temp_t));
+    //   ...
+    //   ArenaPopBackTo(arena, mark);
+    // Note: Not for file-backed arenas, ARENA_FLAG_GUARD is ignored and the arena can't be dirty tracked.
+    // Note: ArenaPushConcurrent only pushes at the front and must not be mixed with the back functions.
+    int_t ArenaPosBack(const arena_t* arena);
+    void* ArenaPushBack(arena_t* arena, int_t size_bytes);
+    void  ArenaPopBackTo(arena_t* arena, int_t position);
+    void  ArenaClearBack(arena_t* arena, int_t keep_commited_bytes = 0); // like ArenaClear, decommit delay is not applied
+
     // Clear the arena, this will only reset the commited size when keep_commited_bytes is less than the current commited size.
+    // The decommit policy of the arena (see ArenaSetPolicy) can keep more pages commited.
     void ArenaClear(arena_t* arena, int_t keep_commited_bytes = 0);
 
     // Commit a specific number of bytes from the arena.
@@ -59,9 +182,80 @@ namespace ncore
     // If `commited > arena.commited`, this will expand the usable range.
     void ArenaCommit(arena_t* arena, int_t set_commited_bytes);
 
+    // Commit growth and decommit policy of an arena, the default (all zero) commits exactly the pages needed and
+    // decommits immediately. With a decommit delay the arena keeps its commited pages over that many Clear/Commit calls
+    // and then shrinks to what the peak usage of those calls needs, so steady reset-and-refill loops don't commit and
+    // decommit over and over.
+    struct arena_policy_t
+    {
+        int_t MinCommitBytes;  // minimum number of bytes to commit when the arena grows
+        s32   GrowthPercent;   // grow by at least this percentage of the commited range (e.g. 100 doubles it)
+        int_t KeepCommitBytes; // low-water mark, Clear and Commit never decommit below this
+        s32   DecommitDelay;   // number of Clear/Commit calls to observe before decommitting (0 = immediately)
+    };
+
+    void ArenaSetPolicy(arena_t* arena, arena_policy_t const& policy);
+    void ArenaGetPolicy(const arena_t* arena, arena_policy_t& policy);
+
+    // Change the NUMA policy of an arena, pages that are already backed are moved to the nodes of the policy.
+    bool ArenaSetNuma(arena_t* arena, nvmem::numa_t const& numa);
+
+    // Telemetry of an arena, cheap enough to always be on, pushes are not tracked individually.
+    struct arena_stats_t
+    {
+        const char* Name;
+        int_t       ReservedBytes;     // size of the reservation
+        int_t       CommitedBytes;     // currently commited bytes
+        int_t       Pos;               // current position
+        int_t       BytesPushed;       // total number of bytes pushed over the lifetime of the arena
+        int_t       PeakPos;           // highest position reached
+        int_t       PeakCommitedBytes; // highest number of commited bytes
+        u64         CommitCount;       // number of commit calls
+        u64         CommitTimeNs;      // total time spent in commit calls
+        u64         DecommitCount;     // number of decommit calls
+        u64         DecommitTimeNs;    // total time spent in decommit calls
+    };
+
+    void ArenaGetStats(const arena_t* arena, arena_stats_t& stats);
+
+    // Walk all live arenas, while other threads are working with their arenas the values are approximate.
+    typedef void (*arena_stats_fn)(const arena_t* arena, arena_stats_t const& stats, void* user);
+    void ArenasForEach(arena_stats_fn fn, void* user);
+
+    // Fill `stats` with the telemetry of up to `max_count` live arenas.
+    // @returns the number of live arenas, this can be larger than `max_count`.
+    s32 ArenasSnapshot(arena_stats_t* stats, s32 max_count);
+
     // @returns true if the arena is valid (it was initialized with valid memory and size).
     bool ArenaIsValid(const arena_t* arena);
 
+    // Scratch arenas, every thread has ARENA_SCRATCH_COUNT arenas for temporary memory that are created on first use.
+    // A scope saves the arena position on ScratchBegin and pops back to it on ScratchEnd, scopes can be nested.
+    // Pass the arenas the caller allocates its output from as conflicts, ScratchBegin will never hand those out.
+    // e.g.
+    //   scratch_t scratch = ScratchBegin(result_arena);
+    //   void* temp = ArenaPush(scratch.Arena, 1024);
+    //   ...
+    //   ScratchEnd(scratch);
+    struct scratch_t
+    {
+        arena_t* Arena; // the scratch arena to allocate temporary memory from
+        int_t    Pos;   // position of the arena when the scope started
+    };
+
+    // Set the size of scratch arenas that are created from now on (default: 64 MiB reserved, 64 KiB commited).
+    void ScratchSetup(int_t reserved_size_in_bytes, int_t commit_size_in_bytes);
+
+    // @returns a scratch arena of the calling thread that is not one of `conflicts`.
+    scratch_t ScratchBegin(arena_t* const* conflicts = nullptr, s32 num_conflicts = 0);
+    scratch_t ScratchBegin(arena_t* conflict);
+    void      ScratchEnd(scratch_t scratch);
+
+    // Release the scratch arenas of the calling thread, this also happens automatically when a thread exits.
+    // Note: ArenasTeardown releases the scratch arenas of the calling thread, scratch arenas of other threads still
+    //       alive at that point are not released.
+    void ScratchRelease();
+
 } // namespace ncore
 
 #endif // __C_VMEM_VIRTUAL_MEMORY_ARENA_H__
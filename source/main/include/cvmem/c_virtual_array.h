@@ -0,0 +1,115 @@
+#ifndef __C_VMEM_VIRTUAL_ARRAY_H__
+#define __C_VMEM_VIRTUAL_ARRAY_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_memory.h"
+#include "cvmem/c_virtual_memory.h"
+
+#include <new>
+#include <type_traits>
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        // A growable array that reserves the address range for the maximum number of items once and commits pages as
+        // it grows, items never move so growing does not copy and pointers to items stay valid.
+        //
+        // e.g.
+        //   nvmem::array_t<entity_t> entities;
+        //   entities.setup(4096, 16777216);
+        //   entities.push_back(entity);
+        //   entities.append(other, count);
+        //   ...
+        //   entities.teardown();
+        //
+        // Trivially copyable items are appended with memcpy and are not destructed, items beyond the highest size ever
+        // reached live on freshly commited pages that are zero, so value-initializing them with `resize` is free.
+        template <typename T> class array_t
+        {
+            T*      m_data;            // memory base pointer
+            u32     m_size;            // number of items
+            u32     m_high;            // items at and beyond this index are on pages that were never commited before
+            u32     m_cap;             // number of items that fit in the commited pages
+            u32     m_page_count;      // number of pages that are commited
+            u32     m_page_max;        // number of pages that are reserved
+            u32     m_page_grow;       // minimum number of pages to commit when the array runs out of capacity
+            s8      m_page_size_shift; // page size shift, page size is (1 << m_page_size_shift)
+            s8      m_page_kind;       // kind of pages backing the array (nvmem::npage)
+            s8      m_commit_mode;     // nvmem::ncommit, Lazy or Populate
+            stats_t m_stats;           // commit and decommit calls
+
+            array_t(array_t const&);
+            array_t& operator=(array_t const&);
+
+        public:
+            array_t();
+            ~array_t() { teardown(); }
+
+            // e.g: setup(32768, 16777216);
+            // `page_size_shift`, `commit_mode` and `numa` are the same as for `pool_t::setup`.
+            bool setup(u32 initial_capacity, u32 maximum_capacity, s8 page_size_shift = 0, ncommit::value_t commit_mode = ncommit::Lazy, numa_t const& numa = numa_t());
+
+            // Destructs the items and releases the address range.
+            bool teardown();
+
+            // When the array runs out of capacity at least `item_count` items worth of pages are commited.
+            // The default is the number of pages commited by `setup` (minimum 1 page).
+            void set_grow_size(u32 item_count);
+
+            // Commit pages so that at least `item_count` items fit without growing.
+            bool reserve(u32 item_count);
+
+            // Items that are added are value-initialized or copies of `value`, items that are removed are destructed.
+            // @returns false when `item_count` is more than the maximum capacity.
+            bool resize(u32 item_count);
+            bool resize(u32 item_count, T const& value);
+
+            // @returns the new item, nullptr when the array is at its maximum capacity.
+            // `item` may be an item of this array, it does not move when the array grows.
+            T* push_back(T const& item);
+            T* push_back(); // value-initialized
+
+            // Append `count` copies of `items`, all or nothing.
+            // @returns the first appended item, nullptr when they don't fit.
+            T* append(T const* items, u32 count);
+
+            void pop_back();
+            void clear();
+
+            // Decommit the pages beyond the last item.
+            bool shrink_to_fit();
+
+            inline bool empty() const { return m_size == 0; }
+            inline u32  size() const { return m_size; }
+            inline u32  capacity() const { return m_cap; }
+            inline u32  max_capacity() const { return (u32)(((u64)m_page_max << m_page_size_shift) / sizeof(T)); }
+
+            inline s8                    page_size_shift() const { return m_page_size_shift; }
+            inline nvmem::npage::value_t page_kind() const { return m_page_kind; }
+            inline stats_t const&        commit_stats() const { return m_stats; }
+
+            inline T*       data() { return m_data; }
+            inline T const* data() const { return m_data; }
+            inline T*       begin() { return m_data; }
+            inline T const* begin() const { return m_data; }
+            inline T*       end() { return m_data + m_size; }
+            inline T const* end() const { return m_data + m_size; }
+            inline T&       back() { return m_data[m_size - 1]; }
+            inline T const& back() const { return m_data[m_size - 1]; }
+            inline T&       operator[](u32 index) { return m_data[index]; }
+            inline T const& operator[](u32 index) const { return m_data[index]; }
+
+        protected:
+            bool grow_to(u32 item_count);
+            void destruct(u32 from, u32 to);
+        };
+    } // namespace nvmem
+}; // namespace ncore
+
+#include "cvmem/private/c_virtual_array_inline.h"
+
+#endif /// __C_VMEM_VIRTUAL_ARRAY_H__
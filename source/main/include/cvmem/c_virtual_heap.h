@@ -0,0 +1,69 @@
+#ifndef __C_VMEM_VIRTUAL_HEAP_H__
+#define __C_VMEM_VIRTUAL_HEAP_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_allocator.h"
+#include "cvmem/c_virtual_memory.h"
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        struct heap_state_t;
+
+        struct heap_stats_t
+        {
+            u64 alloc_count;  // total number of allocations over the lifetime of the heap
+            u64 live_count;   // number of allocations in use
+            u64 live_bytes;   // bytes in use, small allocations are rounded up to their size class
+            u64 commit_bytes; // bytes commited for items, small spans and large allocations
+            u64 large_count;  // number of large allocations in use
+        };
+
+        // General purpose allocator with segregated size classes on virtual memory.
+        // Every size class (16 bytes up to 32 KiB, 4 classes per power of two) has its own region in one reservation,
+        // the region is carved into 64 KiB spans that are commited on demand and hold items of that class only.
+        // Free items are tracked with a bitmap per span, a span that becomes empty is decommited (one empty span per
+        // class is kept to avoid commit/decommit thrashing). Larger allocations get their own reservation that is
+        // commited as a whole and released on deallocate.
+        // Every size class has its own lock, allocate and deallocate can be called from any thread.
+        //
+        // e.g.
+        //   nvmem::heap_t heap;
+        //   heap.setup();
+        //   void* ptr = heap.allocate(100);
+        //   heap.deallocate(ptr);
+        //   heap.teardown();
+        class heap_t : public alloc_t
+        {
+        public:
+            heap_t();
+            ~heap_t();
+
+            // `class_reserve` is the address range reserved for every size class, it limits the bytes that
+            // can be in use per size class (default 256 MiB, the heap reserves 40 times this).
+            bool setup(u64 class_reserve = 256 * cMB);
+
+            // Releases all memory, including large allocations that were not deallocated.
+            bool teardown();
+
+            // @returns the number of bytes that can be used at `ptr`, which is at least the size that was asked for.
+            u32 usable_size(void const* ptr) const;
+
+            void get_stats(heap_stats_t& stats) const;
+
+        protected:
+            virtual void* v_allocate(u32 size, u32 alignment);
+            virtual void  v_deallocate(void* ptr);
+            virtual void  v_release();
+
+        private:
+            heap_state_t* m_state; // lives at the start of its own reservation
+        };
+    } // namespace nvmem
+}; // namespace ncore
+
+#endif /// __C_VMEM_VIRTUAL_HEAP_H__
@@ -24,6 +24,50 @@ namespace ncore
             const value_t ExecuteReadWrite = 6; // You can execute the page memory and read/write to it.
         } // namespace nprotect
 
+        namespace ndecommit
+        {
+            typedef s8 value_t;
+
+            const value_t DontNeed = 0; // Pages are dropped immediately (MADV_DONTNEED), RSS goes down right away. This is the default.
+            const value_t Free     = 1; // Pages are dropped lazily by the OS under memory pressure (MADV_FREE), cheaper but RSS goes down later.
+        } // namespace ndecommit
+
+        namespace npage
+        {
+            typedef s8 value_t;
+
+            const value_t Normal      = 0; // Regular system pages (e.g. 4 KiB).
+            const value_t Transparent = 1; // Regular pages in a range aligned and hinted for transparent huge pages (MADV_HUGEPAGE).
+            const value_t Huge        = 2; // Explicit huge pages (MAP_HUGETLB), the range is backed by pages of the requested size.
+        } // namespace npage
+
+        namespace ncommit
+        {
+            typedef s8 value_t;
+
+            const value_t Lazy     = 0; // Pages are backed by physical memory on first touch (page fault). This is the default.
+            const value_t Populate = 1; // Pages are backed by physical memory when they are commited (see `populate`).
+        } // namespace ncommit
+
+        namespace nnuma
+        {
+            typedef s8 value_t;
+
+            const value_t Default    = 0; // Pages come from the node of the thread that first touches them.
+            const value_t Bind       = 1; // Pages only come from the given nodes, allocation fails when these run out.
+            const value_t Interleave = 2; // Pages are spread round-robin over the given nodes (all nodes when none are given).
+            const value_t Preferred  = 3; // Pages come from the first given node when possible, otherwise from any node.
+        } // namespace nnuma
+
+        // NUMA policy of an address range, `nodes` is a bit mask of node numbers (bit N = node N).
+        // Nodes that don't exist are ignored, when none of the given nodes exist the policy is not applied, so on a
+        // single node system and on platforms without NUMA support (Windows, MacOS) this is a no-op.
+        struct numa_t
+        {
+            nnuma::value_t policy;
+            u64            nodes;
+        };
+
         // Call once at the start of your program.
         // This exists only to cache result of `query_page_size` so you can use faster `get_page_size`,
         // so this is completely optional. If you don't call this `get_page_size` will return 0.
@@ -33,11 +77,106 @@ namespace ncore
         u32 page_size();
 
         bool reserve(u64 address_range, nprotect::value_t attributes, void*& baseptr);
+
+        // Reserve with a requested page size of (1 << page_size_shift) bytes, e.g. 21 for 2 MiB and 30 for 1 GiB pages.
+        // The address range is rounded up to and aligned on the requested page size, commit and decommit ranges
+        // should be multiples of that size. Explicit huge pages are tried first, when they are not available this
+        // falls back to a transparent huge page hint and then to normal pages. `page_kind` reports what was obtained.
+        bool reserve(u64 address_range, nprotect::value_t attributes, s8 page_size_shift, void*& baseptr, npage::value_t& page_kind);
         bool release(void* baseptr, u64 address_range);
 
+        // Reserve with a NUMA policy for the whole range, pages commited later come from the nodes of the policy.
+        bool reserve(u64 address_range, nprotect::value_t attributes, s8 page_size_shift, numa_t const& numa, void*& baseptr, npage::value_t& page_kind);
+
+        // Number of NUMA nodes the process can use, 1 when there is no NUMA support.
+        s32 numa_node_count();
+
+        // Apply a NUMA policy (mbind on Linux) to [address, address + size), pages that are already backed are moved.
+        bool numa_apply(void* address, u64 size, numa_t const& numa);
+
+        // @returns the node that backs the page holding `address`, -1 when the page is not backed or this is unknown.
+        s32 query_node(void const* address);
+
+        // Count the backed pages of [address, address + size) per node, `pages_per_node` has room for `max_nodes` counters.
+        // @returns the number of backed pages in the range.
+        u64 query_nodes(void const* address, u64 size, u64* pages_per_node, s32 max_nodes);
+
         bool commit(void* address, u64 size);
         bool decommit(void* address, u64 size);
 
+        // Back the commited pages in [address, address + size) with physical memory now, so that the first access does
+        // not page fault. Uses MADV_POPULATE_WRITE on Linux and touches every page otherwise, the content is kept.
+        // The range must not be written by other threads while it is populated.
+        // Large ranges are split over a few threads, see `set_populate_threads`.
+        bool populate(void* address, u64 size);
+
+        // Commit and populate, `commit` with ncommit::Populate.
+        bool commit_populate(void* address, u64 size);
+        bool commit(void* address, u64 size, ncommit::value_t mode);
+
+        // Apply a NUMA policy to the range and commit it.
+        bool commit(void* address, u64 size, numa_t const& numa);
+
+        // Ranges of at least 2 * `min_bytes_per_thread` are populated by up to `max_threads` threads (including the caller).
+        // Smaller ranges are populated on the calling thread. Default: 4 threads, 16 MiB per thread (at least 1 MiB).
+        void set_populate_threads(u32 max_threads, u64 min_bytes_per_thread);
+
+        // Memory mapped files, the file is mapped shared so stores to the mapping end up in the file.
+        // Only the part of a mapping that lies within the file can be accessed, growing the file with `file_resize`
+        // makes more of the mapping usable without mapping it again, shrinking it drops the pages beyond the new end.
+        // Not supported on Windows, `file_map` fails there.
+        typedef s64  file_t;
+        const file_t cInvalidFile = -1;
+
+        // Open a file for reading and writing, it is created when it doesn't exist. `size` is the size of the file.
+        // @returns cInvalidFile when the file can't be opened.
+        file_t file_open(const char* path, u64& size);
+        bool   file_close(file_t file);
+        bool   file_resize(file_t file, u64 size);
+
+        // Map the first `address_range` bytes of a file, at `address` when that range is free, otherwise anywhere.
+        bool file_map(file_t file, u64 address_range, void* address, void*& baseptr);
+        bool file_unmap(void* baseptr, u64 address_range);
+
+        // Write the modified pages of [address, address + size) of a file mapping to the file and wait until that is done.
+        bool flush(void* address, u64 size);
+
+        // An in-memory file without a name (memfd on Linux, an unlinked temporary file elsewhere), it is gone when it is closed.
+        file_t file_anonymous();
+
+        // Write all modified pages of the file to storage and wait until that is done (fsync).
+        bool file_sync(file_t file);
+
+        // Map [offset, offset + size) of a file over the pages at [address, address + size), replacing what was mapped
+        // there. With `copy_on_write` stores copy the page and are not seen by the file (MAP_PRIVATE).
+        bool file_remap(file_t file, u64 offset, void* address, u64 size, bool copy_on_write);
+
+        // Write the pages of a copy-on-write mapping at [address, address + size) that were stored to back into the file at
+        // `offset`. On Linux only those pages are written (found through /proc/self/pagemap), elsewhere the whole range is.
+        bool file_writeback(file_t file, u64 offset, void const* address, u64 size);
+
+        // Map the same `size` bytes of memory twice, back to back, at [baseptr, baseptr + 2 * size). A byte written at
+        // baseptr + i is also at baseptr + size + i, so a block that runs past the end of the first half continues at
+        // the start of the memory ("magic" ring buffer). `size` is rounded up to the allocation granularity.
+        bool mirror_alloc(u64& size, void*& baseptr);
+        bool mirror_release(void* baseptr, u64 size);
+
+        // Counters of commit and decommit calls, arenas and pools keep one of these to track the cost of growing and shrinking.
+        struct stats_t
+        {
+            u64 commit_count;
+            u64 commit_time_ns;
+            u64 decommit_count;
+            u64 decommit_time_ns;
+        };
+
+        // Same as `commit` and `decommit`, also counting and timing the call in `stats`.
+        bool commit(void* address, u64 size, stats_t& stats);
+        bool decommit(void* address, u64 size, stats_t& stats);
+
+        // Monotonic clock in nanoseconds, used for timing the commit and decommit calls.
+        u64 query_time_ns(void);
+
         // Global memory status.
         struct usage_t
         {
@@ -57,6 +196,7 @@ namespace ncore
         void* alloc_and_commit(const int_t num_bytes);
 
         // Reserve (allocate but don't commit) a block of static address-space of size `num_bytes`
+        // `protect` is only validated, the range is not accessible until it is commited with `commit_protect`.
         // @returns 0 on error, start address of the allocated memory block on success.
         void* alloc_protect(int_t num_bytes, nprotect::value_t protect);
 
@@ -80,7 +220,8 @@ namespace ncore
         bool commit(void* ptr, const int_t num_bytes);
 
         // Decommits the memory pages which contain one or more bytes in [ptr...ptr+num_bytes]. The pages will be unmapped from
-        // physical memory.
+        // physical memory and become inaccessible until they are commited again. How the physical pages are returned
+        // to the OS is controlled by `set_decommit_mode`, the content of a page that is commited again is undefined.
         // @param ptr: pointer to the pointer returned by `alloc` or shifted by [0...num_bytes].
         // @param num_bytes: number of bytes to decommit.
         bool decommit(void* ptr, int_t num_bytes);
@@ -90,12 +231,34 @@ namespace ncore
         // If `commited > prev_commited`, this will expand the usable range.
         bool partially_commit_region(void* ptr, int_t num_bytes, int_t prev_commited, int_t commited);
 
+        // Select how `decommit` returns physical pages to the OS, see `ndecommit`.
+        // Windows always uses MEM_DECOMMIT and ignores this setting.
+        void               set_decommit_mode(ndecommit::value_t mode);
+        ndecommit::value_t get_decommit_mode();
+
+        // Guard mode to catch overruns in production (off by default). Arenas and pools set up while it is on reserve
+        // a NoAccess page after their range and arenas behave as if created with ARENA_FLAG_GUARD, so an access past
+        // the end faults at native speed instead of every access being checked.
+        void set_guard_mode(bool enabled);
+        bool get_guard_mode();
+
         // Sets protection mode for the region of pages. All of the pages must be commited.
         bool protect(void* ptr, int_t num_bytes, nprotect::value_t protect);
 
+        // Handler for stores to pages that are not writable, e.g. pages that were write-protected to see which pages
+        // are stored to. Faults on unmapped addresses and, where the platform reports it, reads don't reach the handler.
+        // The handler is called from the fault (a signal handler on POSIX) with the faulting address,
+        // when it makes the page writable and returns true the store is retried, otherwise the fault goes to the
+        // handler that was installed before. There is one handler per process, nullptr removes it.
+        typedef bool (*write_fault_fn)(void* address);
+        bool set_write_fault_handler(write_fault_fn fn);
+
         // @returns cached value from `query_page_size`. Returns 0 if you don't call `init`.
         u32 get_page_size(void);
 
+        // @returns log2 of `get_page_size`, e.g. 12 for 4096 bytes. Returns 0 if you don't call `init`.
+        s8 get_page_size_shift(void);
+
         // Query the page size from the system. Usually something like 4096 bytes.
         // @returns the page size in number bytes. Cannot fail.
         u32 query_page_size(void);
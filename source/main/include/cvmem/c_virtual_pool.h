@@ -6,37 +6,202 @@
 #endif
 
 #include "cbase/c_allocator.h"
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_reclaim.h"
 
 namespace ncore
 {
     namespace nvmem
     {
-        template <typename T> class pool_t : public ncore::pool_t<T>
+        // Telemetry of a pool, cheap enough to always be on.
+        struct pool_stats_t
         {
-            u8* m_baseptr;     // memory base pointer
-            u32 m_item_sizeof; // the size of an item in bytes
-            u32 m_item_count;  // current number of items that are used
-            u32 m_item_cap;    // maximum number of items that can be used
-            u32 m_free_index;  // index of the first free item
-            u32 m_free_head;   // index of the first free item in the free list
+            u64     alloc_count;      // total number of allocations over the lifetime of the pool
+            u32     item_count;       // current number of items in use
+            u32     peak_item_count;  // highest number of items in use at the same time
+            u32     page_count;       // currently commited pages
+            u32     peak_page_count;  // highest number of commited pages
+            u32     empty_page_count; // commited pages without any item in use
+            u32     trim_page_count;  // total number of pages decommited by trimming
+            u32     page_max;         // number of reserved pages
+            s8      page_size_shift;  // page size is (1 << page_size_shift)
+            stats_t commit_stats;     // commit and decommit calls
+        };
+
+        // Handle of a pool item, the item index in the low 32 bits and the generation of the slot in the high 32 bits.
+        // The generation of a slot is bumped when its item is deallocated, so a handle to an item that was deallocated
+        // does not resolve to the item that reuses the slot (until the 32 bit generation wraps around).
+        typedef u64    handle_t;
+        const handle_t cInvalidHandle = 0xffffffffffffffffull;
+
+        inline u32 handle_index(handle_t handle) { return (u32)handle; }
+        inline u32 handle_generation(handle_t handle) { return (u32)(handle >> 32); }
+
+        // A pool of items on virtual memory, the address range for the maximum number of items is reserved once and
+        // pages are commited as the pool grows, items never move.
+        // The size of an item slot is a compile-time constant, `Stride` pads items to a larger (e.g. power-of-two) slot
+        // so that index/pointer conversion is a shift, e.g. `nvmem::pool_t<particle_t, 64>`.
+        // `allocate`, `deallocate` and the handle functions do not go through the virtual interface of `ncore::pool_t`
+        // and inline at the call site.
+        template <typename T, u32 Stride = sizeof(T)> class pool_t : public ncore::pool_t<T>
+        {
+            static_assert(Stride >= sizeof(T) && (Stride % alignof(T)) == 0, "Stride must hold an item and keep items aligned");
+
+            u8*     m_baseptr;         // memory base pointer
+            u64*    m_live;            // occupancy bitmap, bit set = item is allocated
+            u64*    m_free_words;      // summary of the bitmap, bit set = the bitmap word has a free item below m_free_index
+            u32*    m_page_live;       // per page the number of allocated items on it, cPageTrimmed when it is decommited
+            u32*    m_generation;      // per item the generation of the slot, bumped on deallocate
+            u64     m_meta_range;      // reserved size of the bitmap, the summary, the page counts and the generations
+            u32     m_meta_pages;      // number of pages whose metadata is commited
+            u32     m_item_count;      // current number of items that are used
+            u32     m_item_cap;        // maximum number of items that can be used
+            u32     m_free_index;      // items at and above this index have never been used
+            u32     m_free_hint;       // summary words before this one are zero
+            u32     m_page_count;      // number of pages that are commited or trimmed, the pages below the capacity
+            u32     m_page_max;        // number of pages that are reserved
+            u32     m_page_grow;       // number of pages to commit when the pool runs out of items
+            u32     m_page_empty;      // number of commited pages without items
+            u32     m_page_trimmed;    // number of pages below m_page_count that are decommited
+            u32     m_trim_pages;      // trim when more than this number of pages is empty, 0 = never
+            s8      m_page_size_shift; // page size shift, page size is (1 << m_page_size_shift)
+            s8      m_page_kind;       // kind of pages backing the pool (nvmem::npage)
+            s8      m_commit_mode;     // nvmem::ncommit, Lazy or Populate
+            s8      m_guard_pages;     // number of NoAccess pages reserved after the items, 1 in guard mode (see `set_guard_mode`)
+            u32     m_peak_count;      // telemetry: highest number of items in use
+            u32     m_peak_pages;      // telemetry: highest number of commited pages
+            u32     m_trim_count;      // telemetry: total number of pages decommited by trimming
+            u64     m_alloc_count;     // telemetry: total number of allocations
+            stats_t m_stats;           // telemetry: commit and decommit calls
 
         public:
             pool_t();
 
             // e.g: setup(32768, 16777216);
-            bool setup(u32 initial_item_count, u32 maximum_item_count);
+            // A `page_size_shift` of 0 uses the system page size, 21 (2 MiB) or 30 (1 GiB) asks for huge pages and
+            // falls back to normal pages when they are not available, see `page_kind`.
+            // With ncommit::Populate pages are populated when they are commited, by setup and by growing.
+            // The NUMA policy applies to the whole reservation, see `nvmem::numa_t`.
+            bool setup(u32 initial_item_count, u32 maximum_item_count, s8 page_size_shift = 0, ncommit::value_t commit_mode = ncommit::Lazy, numa_t const& numa = numa_t());
+
+            // When the background reclaimer is running (see `nvmem::reclaim_start`) the memory is released by the reclaimer.
             bool teardown();
 
+            // When all commited items are in use the pool commits more pages, at least `item_count` items worth,
+            // until the reserved maximum is reached. Items never move, indices and pointers stay valid.
+            // The default is the number of pages commited by `setup` (minimum 1 page).
+            void set_grow_size(u32 item_count);
+
+            // Commit pages so that at least `item_count` items are available without growing.
+            bool reserve(u32 item_count);
+
+            // Items are allocated lowest index first, so the items in use gather on the lower pages and pages higher
+            // up become empty after a peak. Trimming decommits the pages without any item in use, except for the
+            // lowest `keep_pages` of them. A trimmed page is commited again when an item on it is allocated.
+            // @returns the number of pages that were decommited.
+            u32 trim(u32 keep_pages = 0);
+
+            // Trim automatically on deallocate when, on top of the grow size (see `set_grow_size`), more than
+            // `item_count` items worth of pages are empty. The grow size worth of pages is kept.
+            // 0 disables this, which is the default.
+            void set_trim_threshold(u32 item_count);
+
             inline u32 capacity() const { return m_item_cap; }
+            inline u32 max_capacity() const { return (u32)(((u64)m_page_max << m_page_size_shift) / Stride); }
             inline u32 size() const { return m_item_count; }
 
+            void get_stats(pool_stats_t& stats) const;
+
+            inline s8                    page_size_shift() const { return m_page_size_shift; }
+            inline nvmem::npage::value_t page_kind() const { return m_page_kind; }
+
+            inline T* allocate()
+            {
+                const u32 index = allocate_index();
+                return index != cInvalidIndex ? ptr_at(index) : nullptr;
+            }
+            inline void deallocate(T* item) { deallocate_index(idx_of(item)); }
+
+            // Allocate up to `count` items into `items`, free items are taken a bitmap word (64 items) at a time.
+            // @returns the number of items that were allocated, less than `count` when the pool is full.
+            u32 allocate_n(T** items, u32 count);
+
+            // Deallocate `count` items, items next to each other in `items` that share a bitmap word are released together.
+            void deallocate_n(T* const* items, u32 count);
+
+            // e.g.
+            //   nvmem::handle_t handle;
+            //   entity_t* e = pool.allocate(handle);
+            //   ...
+            //   if (entity_t* e = pool.try_get(handle)) { ... }
+            inline T* allocate(handle_t& handle)
+            {
+                T* item = allocate();
+                handle  = item != nullptr ? handle_of(item) : cInvalidHandle;
+                return item;
+            }
+            inline void deallocate(handle_t handle)
+            {
+                if (T* item = try_get(handle))
+                    deallocate(item);
+            }
+
+            inline handle_t handle_of(T const* item) const
+            {
+                const u32 index = idx_of(item);
+                return ((u64)m_generation[index] << 32) | index;
+            }
+
+            // @returns the item of the handle, nullptr when the handle is stale or invalid.
+            inline T* try_get(handle_t handle)
+            {
+                const u32 index = (u32)handle;
+                return (index < m_free_index && m_generation[index] == (u32)(handle >> 32)) ? ptr_at(index) : nullptr;
+            }
+            inline T const* try_get(handle_t handle) const
+            {
+                const u32 index = (u32)handle;
+                return (index < m_free_index && m_generation[index] == (u32)(handle >> 32)) ? ptr_at(index) : nullptr;
+            }
+
             inline T*       ptr() { return (T*)m_baseptr; }
             inline T const* ptr() const { return (T*)m_baseptr; }
-            inline T*       ptr_at(u32 index) { return (T*)(m_baseptr + index * m_item_sizeof); }
-            inline T const* ptr_at(u32 index) const { return (T const*)(m_baseptr + index * m_item_sizeof); }
-            inline u32      idx_of(T const* item) const { return (u32)((u8*)item - m_baseptr) / m_item_sizeof; }
+            inline T*       ptr_at(u32 index) { return (T*)(m_baseptr + (u64)index * Stride); }
+            inline T const* ptr_at(u32 index) const { return (T const*)(m_baseptr + (u64)index * Stride); }
+            inline u32      idx_of(T const* item) const { return (u32)((u64)((u8 const*)item - m_baseptr) / Stride); }
+
+            // Iterate over the allocated items in index order, the occupancy bitmap is scanned a word (64 items) at a
+            // time, empty words are skipped and full words need no bit operations.
+            // e.g. pool.for_each_live([](entity_t* e, u32 index) { e->update(); });
+            // `fn` may deallocate the item it is given but no other items, items allocated by `fn` may or may not be visited.
+            template <typename F> void for_each_live(F fn);
+
+            enum
+            {
+                cInvalidIndex = 0xffffffff,
+            };
+
+            // e.g. for (u32 i = pool.first_live(); i != pool.cInvalidIndex; i = pool.next_live(i))
+            inline u32  first_live() const { return find_live(0); }
+            inline u32  next_live(u32 index) const { return find_live(index + 1); }
+            inline bool is_live(u32 index) const { return index < m_free_index && (m_live[index >> 6] & ((u64)1 << (index & 63))) != 0; }
 
         protected:
+            enum
+            {
+                cPageTrimmed = 0xffffffff,
+            };
+
+            u32  find_live(u32 index) const;
+            u32  allocate_index();
+            void deallocate_index(u32 index);
+            bool grow(u32 num_pages);
+            bool commit_pages(u32 first_page, u32 num_pages);
+            bool commit_meta(u32 page_end);
+            bool occupy_pages(u32 index);
+            void vacate_pages(u32 index);
+            void update_free_word(u32 word);
+
             virtual u32   v_allocsize() const final;
             virtual void* v_allocate() final;
             virtual void  v_deallocate(void*) final;
@@ -0,0 +1,103 @@
+#ifndef __C_VMEM_VIRTUAL_POOL_CONCURRENT_H__
+#define __C_VMEM_VIRTUAL_POOL_CONCURRENT_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_allocator.h"
+#include "cvmem/c_virtual_memory.h"
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        struct cpool_state_t;
+
+        // Untyped engine of the concurrent pool.
+        // Every thread caches free item indices in two magazines (loaded and previous), allocate and deallocate only touch
+        // these thread-local magazines in the common case. Full and empty magazines are exchanged through a lock-free depot,
+        // and when the depot is empty a whole magazine is refilled in one go from the never used part of the pool.
+        // Pages are commited on demand up to the reserved maximum, items never move.
+        // Limits: at most `cMaxPools` concurrent pools can exist at the same time and `cMaxThreads` threads can use one pool.
+        class cpool_core_t
+        {
+        public:
+            enum
+            {
+                cMagazineSize = 62,   // number of item indices in one magazine (magazine is 256 bytes)
+                cMaxPools     = 64,   // maximum number of concurrent pools that can exist at the same time
+                cMaxThreads   = 4096, // maximum number of threads that can use a single concurrent pool
+                cInvalidIndex = 0xffffffff,
+            };
+
+            cpool_core_t();
+
+            bool setup(u32 item_sizeof, u32 initial_item_count, u32 maximum_item_count, s8 page_size_shift);
+            bool teardown();
+
+            u32  allocate();           // @returns an item index or cInvalidIndex when the pool is exhausted
+            void deallocate(u32 index);
+
+            // Return the magazines of the calling thread to the depot, this also happens automatically when a thread exits.
+            void flush();
+
+            u32 capacity() const;     // number of items that are commited
+            u32 max_capacity() const; // number of items that fit in the reservation
+
+            u8* m_baseptr;     // memory base pointer of the items
+            u32 m_item_sizeof; // the size of an item in bytes
+
+        private:
+            cpool_state_t* m_state; // shared state, lives at the start of its own reservation
+        };
+
+        // Thread-safe pool, allocate and deallocate can be called from any thread without external locking.
+        // Note: teardown must only be called when no other thread is using the pool anymore.
+        template <typename T> class cpool_t : public ncore::pool_t<T>
+        {
+            cpool_core_t m_core;
+
+        public:
+            inline cpool_t() {}
+
+            // e.g: setup(32768, 16777216);
+            inline bool setup(u32 initial_item_count, u32 maximum_item_count, s8 page_size_shift = 0)
+            {
+                u32 const item_align = alignof(T);
+                u32 const item_size  = (sizeof(T) + (item_align - 1)) & ~(item_align - 1);
+                return m_core.setup(item_size, initial_item_count, maximum_item_count, page_size_shift);
+            }
+            inline bool teardown() { return m_core.teardown(); }
+            inline void flush() { m_core.flush(); }
+
+            inline u32 capacity() const { return m_core.capacity(); }
+            inline u32 max_capacity() const { return m_core.max_capacity(); }
+
+            inline T*   allocate() { return (T*)v_allocate(); }
+            inline void deallocate(T* item) { v_deallocate(item); }
+
+            inline T*       ptr_at(u32 index) { return (T*)(m_core.m_baseptr + (u64)index * m_core.m_item_sizeof); }
+            inline T const* ptr_at(u32 index) const { return (T const*)(m_core.m_baseptr + (u64)index * m_core.m_item_sizeof); }
+            inline u32      idx_of(T const* item) const { return (u32)(((u8 const*)item - m_core.m_baseptr) / m_core.m_item_sizeof); }
+
+        protected:
+            virtual u32   v_allocsize() const final { return m_core.m_item_sizeof; }
+            virtual void* v_allocate() final
+            {
+                u32 const index = m_core.allocate();
+                return index != cpool_core_t::cInvalidIndex ? ptr_at(index) : nullptr;
+            }
+            virtual void v_deallocate(void* ptr) final
+            {
+                if (ptr != nullptr)
+                    m_core.deallocate(idx_of((T const*)ptr));
+            }
+
+            virtual void* v_idx2ptr(u32 index) final { return ptr_at(index); }
+            virtual u32   v_ptr2idx(void const* ptr) const final { return idx_of((T const*)ptr); }
+        };
+    } // namespace nvmem
+}; // namespace ncore
+
+#endif /// __C_VMEM_VIRTUAL_POOL_CONCURRENT_H__
@@ -0,0 +1,68 @@
+#ifndef __C_VMEM_VIRTUAL_RECLAIM_H__
+#define __C_VMEM_VIRTUAL_RECLAIM_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cvmem/c_virtual_memory.h"
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        // Background reclaimer, an opt-in thread that does decommit and release calls for arenas and pools so that the
+        // thread releasing memory only pays for putting a request on a queue.
+        // Requests are handled in order and in batches, a request gets a ticket that can be waited on.
+        // When the queue is full the caller waits until the reclaimer has made room (backpressure).
+        // While the reclaimer is not running the async functions do the work on the calling thread and return ticket 0.
+        //
+        // e.g.
+        //   nvmem::reclaim_start();
+        //   ...
+        //   ArenaRelease(arena); // returns right away, the arena slot is reused after the reclaimer released the memory
+        //   ...
+        //   nvmem::reclaim_stop();
+
+        // Called on the reclaimer thread when a release is done.
+        typedef void (*reclaim_fn)(void* user);
+
+        // Start the reclaimer thread, `queue_capacity` is the number of requests that can be queued before callers have
+        // to wait, `batch_size` the maximum number of requests the reclaimer takes from the queue in one go.
+        bool reclaim_start(u32 queue_capacity = 4096, u32 batch_size = 64);
+
+        // Finish all queued requests and stop the reclaimer thread.
+        // Note: Start and stop are not thread-safe, call them when no other thread is releasing memory.
+        void reclaim_stop();
+
+        bool reclaim_running();
+
+        // Queue a decommit, the range must not be commited again before the ticket is done (see `reclaim_wait`).
+        // @returns the ticket of the request, 0 when it was done on the calling thread.
+        u64 decommit_async(void* address, u64 size);
+        u64 decommit_async(void* address, u64 size, stats_t& stats); // counts the call, time is the time the caller spent
+
+        // Queue a release of a reservation, `done` is called with `user` after the address range has been released.
+        u64 release_async(void* baseptr, u64 address_range, reclaim_fn done = nullptr, void* user = nullptr);
+
+        bool reclaim_done(u64 ticket);
+        void reclaim_wait(u64 ticket);
+        void reclaim_flush(); // wait until all queued requests are done
+
+        struct reclaim_stats_t
+        {
+            u64 queued;         // number of requests queued
+            u64 completed;      // number of requests done
+            u64 batches;        // number of batches the reclaimer handled
+            u64 stalls;         // number of times a caller had to wait for room in the queue
+            u64 failures;       // number of decommit and release calls that failed
+            u64 decommit_bytes; // total bytes decommited
+            u64 release_bytes;  // total bytes released
+        };
+
+        void reclaim_get_stats(reclaim_stats_t& stats);
+
+    } // namespace nvmem
+} // namespace ncore
+
+#endif // __C_VMEM_VIRTUAL_RECLAIM_H__
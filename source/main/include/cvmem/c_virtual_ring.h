@@ -0,0 +1,57 @@
+#ifndef __C_VMEM_VIRTUAL_RING_H__
+#define __C_VMEM_VIRTUAL_RING_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cvmem/c_virtual_memory.h"
+
+#include <atomic>
+
+namespace ncore
+{
+    namespace nvmem
+    {
+        // Single producer, single consumer byte ring on a mirrored mapping (see `mirror_alloc`). Every block that is
+        // written or read is contiguous in memory, also when it wraps around the end of the ring, so a record never
+        // has to be split or copied into a bounce buffer.
+        // e.g.
+        //   producer: if (u8* dst = ring.write_begin(n)) { memcpy(dst, record, n); ring.write_end(n); }
+        //   consumer: u32 n; u8 const* src = ring.read_begin(n); ring.read_end(parse(src, n));
+        // One thread may write and another thread may read at the same time, setup and teardown are not thread-safe.
+        class ring_t
+        {
+        public:
+            ring_t();
+
+            // The capacity is rounded up to a power of two of at least the allocation granularity.
+            bool setup(u32 capacity);
+            bool teardown();
+
+            // Producer: @returns `size` contiguous bytes to write to, nullptr when less than `size` bytes are free.
+            u8*  write_begin(u32 size);
+            void write_end(u32 size); // publish the first `size` bytes of the last write_begin to the consumer
+
+            // Consumer: @returns the published bytes that were not consumed yet, `size` is set to their number.
+            u8 const* read_begin(u32& size);
+            void      read_end(u32 size); // hand the first `size` bytes of the last read_begin back to the producer
+
+            inline u32 capacity() const { return m_capacity; }
+            u32        size() const; // number of published bytes that were not consumed yet
+
+        private:
+            u8* m_baseptr;  // base of the mirrored mapping, 2 * m_capacity bytes
+            u32 m_capacity; // size of the ring, a power of two
+            u32 m_mask;     // m_capacity - 1
+
+            // Positions are monotonic byte counters, the offset into the ring is (position & m_mask).
+            alignas(64) std::atomic<u64> m_write;      // producer: published position, read by the consumer
+            u64                          m_read_seen;  // producer: last read position seen, refreshed when the ring looks full
+            alignas(64) std::atomic<u64> m_read;       // consumer: consumed position, read by the producer
+            u64                          m_write_seen; // consumer: last write position seen
+        };
+    } // namespace nvmem
+}; // namespace ncore
+
+#endif /// __C_VMEM_VIRTUAL_RING_H__
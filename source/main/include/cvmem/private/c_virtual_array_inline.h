@@ -0,0 +1,233 @@
+namespace ncore
+{
+    namespace nvmem
+    {
+        template <typename T>
+        array_t<T>::array_t()
+            : m_data(nullptr)
+            , m_size(0)
+            , m_high(0)
+            , m_cap(0)
+            , m_page_count(0)
+            , m_page_max(0)
+            , m_page_grow(1)
+            , m_page_size_shift(0)
+            , m_page_kind(nvmem::npage::Normal)
+            , m_commit_mode(nvmem::ncommit::Lazy)
+        {
+            m_stats = {0, 0, 0, 0};
+        }
+
+        static inline u32 s_array_pages(u32 item_size, u32 item_count, s8 page_size_shift) { return (u32)((((u64)item_count * item_size) + (((u64)1 << page_size_shift) - 1)) >> page_size_shift); }
+
+        template <typename T> bool array_t<T>::setup(u32 initial_capacity, u32 maximum_capacity, s8 page_size_shift, ncommit::value_t commit_mode, numa_t const& numa)
+        {
+            teardown();
+
+            nvmem::initialize();
+            const s8 system_page_size_shift = nvmem::get_page_size_shift();
+            m_page_size_shift               = page_size_shift < system_page_size_shift ? system_page_size_shift : (page_size_shift > 30 ? 30 : page_size_shift);
+            m_page_max                      = s_array_pages(sizeof(T), maximum_capacity, m_page_size_shift);
+
+            const u64             maximum_address_range = (u64)m_page_max << m_page_size_shift;
+            void*                 baseptr;
+            nvmem::npage::value_t page_kind;
+            if (m_page_max == 0 || !nvmem::reserve(maximum_address_range, nvmem::nprotect::ReadWrite, m_page_size_shift, numa, baseptr, page_kind))
+            {
+                m_page_max = 0;
+                return false;
+            }
+
+            m_data        = (T*)baseptr;
+            m_page_kind   = page_kind;
+            m_commit_mode = commit_mode;
+            m_size        = 0;
+            m_high        = 0;
+            m_cap         = 0;
+            m_page_count  = 0;
+            m_page_grow   = 1;
+            m_stats       = {0, 0, 0, 0};
+
+            if (initial_capacity > 0)
+            {
+                if (!grow_to(initial_capacity < maximum_capacity ? initial_capacity : maximum_capacity))
+                {
+                    nvmem::release(m_data, maximum_address_range);
+                    m_data     = nullptr;
+                    m_page_max = 0;
+                    return false;
+                }
+                m_page_grow = m_page_count;
+            }
+            return true;
+        }
+
+        template <typename T> bool array_t<T>::teardown()
+        {
+            if (m_data == nullptr)
+                return true;
+            destruct(0, m_size);
+            if (!nvmem::release(m_data, (u64)m_page_max << m_page_size_shift))
+                return false;
+            m_data       = nullptr;
+            m_size       = 0;
+            m_high       = 0;
+            m_cap        = 0;
+            m_page_count = 0;
+            m_page_max   = 0;
+            m_page_grow  = 1;
+            return true;
+        }
+
+        template <typename T> void array_t<T>::set_grow_size(u32 item_count)
+        {
+            m_page_grow = s_array_pages(sizeof(T), item_count > 0 ? item_count : 1, m_page_size_shift);
+        }
+
+        template <typename T> bool array_t<T>::grow_to(u32 item_count)
+        {
+            if (item_count <= m_cap)
+                return true;
+
+            const u32 page_need = s_array_pages(sizeof(T), item_count, m_page_size_shift);
+            if (page_need > m_page_max)
+                return false;
+
+            u32 num_pages = page_need - m_page_count;
+            if (num_pages < m_page_grow)
+                num_pages = (m_page_max - m_page_count) < m_page_grow ? (m_page_max - m_page_count) : m_page_grow;
+
+            u8* const page_address = (u8*)m_data + ((u64)m_page_count << m_page_size_shift);
+            const u64 size         = (u64)num_pages << m_page_size_shift;
+            if (!nvmem::commit(page_address, size, m_stats))
+                return false;
+            if (m_commit_mode == nvmem::ncommit::Populate && !nvmem::populate(page_address, size))
+            {
+                // Fail like a failed commit, the capacity stays where it was
+                nvmem::decommit(page_address, size, m_stats);
+                return false;
+            }
+
+            m_page_count += num_pages;
+            m_cap = (u32)(((u64)m_page_count << m_page_size_shift) / sizeof(T));
+            return true;
+        }
+
+        template <typename T> bool array_t<T>::reserve(u32 item_count) { return grow_to(item_count); }
+
+        template <typename T> void array_t<T>::destruct(u32 from, u32 to)
+        {
+            if (!std::is_trivially_destructible<T>::value)
+            {
+                for (u32 i = from; i < to; ++i)
+                    m_data[i].~T();
+            }
+        }
+
+        template <typename T> bool array_t<T>::resize(u32 item_count)
+        {
+            if (item_count <= m_size)
+            {
+                destruct(item_count, m_size);
+                m_size = item_count;
+                return true;
+            }
+            if (!grow_to(item_count))
+                return false;
+
+            if (std::is_trivial<T>::value)
+            {
+                // only the items below the high water mark can be dirty
+                const u32 dirty = item_count < m_high ? item_count : m_high;
+                if (dirty > m_size)
+                    nmem::memset(m_data + m_size, 0, (u64)(dirty - m_size) * sizeof(T));
+            }
+            else
+            {
+                for (u32 i = m_size; i < item_count; ++i)
+                    new (m_data + i) T();
+            }
+            m_size = item_count;
+            m_high = m_size > m_high ? m_size : m_high;
+            return true;
+        }
+
+        template <typename T> bool array_t<T>::resize(u32 item_count, T const& value)
+        {
+            if (item_count <= m_size)
+                return resize(item_count);
+            if (!grow_to(item_count))
+                return false;
+            for (u32 i = m_size; i < item_count; ++i)
+                new (m_data + i) T(value);
+            m_size = item_count;
+            m_high = m_size > m_high ? m_size : m_high;
+            return true;
+        }
+
+        template <typename T> T* array_t<T>::push_back(T const& item)
+        {
+            if (m_size == m_cap && !grow_to(m_size + 1))
+                return nullptr;
+            T* p = new (m_data + m_size) T(item);
+            m_size++;
+            m_high = m_size > m_high ? m_size : m_high;
+            return p;
+        }
+
+        template <typename T> T* array_t<T>::push_back()
+        {
+            if (!resize(m_size + 1))
+                return nullptr;
+            return m_data + m_size - 1;
+        }
+
+        template <typename T> T* array_t<T>::append(T const* items, u32 count)
+        {
+            if (count > (max_capacity() - m_size) || !grow_to(m_size + count))
+                return nullptr;
+
+            T* const first = m_data + m_size;
+            if (std::is_trivially_copyable<T>::value)
+            {
+                nmem::memcpy(first, items, (u64)count * sizeof(T));
+            }
+            else
+            {
+                for (u32 i = 0; i < count; ++i)
+                    new (first + i) T(items[i]);
+            }
+            m_size += count;
+            m_high = m_size > m_high ? m_size : m_high;
+            return first;
+        }
+
+        template <typename T> void array_t<T>::pop_back()
+        {
+            destruct(m_size - 1, m_size);
+            m_size--;
+        }
+
+        template <typename T> void array_t<T>::clear()
+        {
+            destruct(0, m_size);
+            m_size = 0;
+        }
+
+        template <typename T> bool array_t<T>::shrink_to_fit()
+        {
+            const u32 page_keep = s_array_pages(sizeof(T), m_size, m_page_size_shift);
+            if (page_keep >= m_page_count)
+                return true;
+
+            u8* const page_address = (u8*)m_data + ((u64)page_keep << m_page_size_shift);
+            if (!nvmem::decommit(page_address, (u64)(m_page_count - page_keep) << m_page_size_shift, m_stats))
+                return false;
+
+            // m_high stays, the content of a page that is commited again is undefined (see nvmem::decommit)
+            m_page_count = page_keep;
+            m_cap        = (u32)(((u64)m_page_count << m_page_size_shift) / sizeof(T));
+            return true;
+        }
+    } // namespace nvmem
+} // namespace ncore
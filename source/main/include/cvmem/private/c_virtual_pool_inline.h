@@ -1,98 +1,567 @@
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
 namespace ncore
 {
     namespace nvmem
     {
-        template <typename T>
-        pool_t<T>::pool_t()
+#if defined(_MSC_VER)
+        static inline u32 s_pool_lowest_bit(u64 v)
+        {
+            unsigned long i;
+            _BitScanForward64(&i, v);
+            return (u32)i;
+        }
+#else
+        static inline u32 s_pool_lowest_bit(u64 v) { return (u32)__builtin_ctzll(v); }
+#endif
+
+        template <typename T, u32 Stride>
+        pool_t<T, Stride>::pool_t()
             : m_baseptr(nullptr)
-            , m_item_sizeof(0)
+            , m_live(nullptr)
+            , m_free_words(nullptr)
+            , m_page_live(nullptr)
+            , m_generation(nullptr)
+            , m_meta_range(0)
+            , m_meta_pages(0)
             , m_item_count(0)
             , m_item_cap(0)
             , m_free_index(0)
-            , m_free_head(0xffffffff)
+            , m_free_hint(0)
+            , m_page_count(0)
+            , m_page_max(0)
+            , m_page_grow(1)
+            , m_page_empty(0)
+            , m_page_trimmed(0)
+            , m_trim_pages(0)
+            , m_page_size_shift(0)
+            , m_page_kind(nvmem::npage::Normal)
+            , m_commit_mode(nvmem::ncommit::Lazy)
+            , m_guard_pages(0)
+            , m_peak_count(0)
+            , m_peak_pages(0)
+            , m_trim_count(0)
+            , m_alloc_count(0)
         {
+            m_stats = {0, 0, 0, 0};
         }
 
-        static inline u32 s_number_of_pages(u32 item_size, u32 item_count, s8 page_size_shift) { return ((item_count * item_size) + ((1 << page_size_shift) - 1)) >> page_size_shift; }
+        static inline u32 s_number_of_pages(u32 item_size, u32 item_count, s8 page_size_shift) { return (u32)((((u64)item_count * item_size) + (((u64)1 << page_size_shift) - 1)) >> page_size_shift); }
+
+        // Sizes of the metadata sections for `item_count` items and `page_count` pages, see `commit_meta`.
+        static inline u64 s_pool_live_bytes(u64 item_count) { return ((item_count + 63) >> 6) * sizeof(u64); }
+        static inline u64 s_pool_free_bytes(u64 item_count) { return ((((item_count + 63) >> 6) + 63) >> 6) * sizeof(u64); }
+        static inline u64 s_pool_count_bytes(u64 page_count) { return page_count * sizeof(u32); }
+        static inline u64 s_pool_generation_bytes(u64 item_count) { return item_count * sizeof(u32); }
 
-        template <typename T> bool pool_t<T>::setup(u32 initial_item_count, u32 maximum_item_count)
+        static inline bool s_pool_commit_section(void* section, u64 old_bytes, u64 new_bytes, u64 page_size)
         {
-            m_baseptr            = nullptr;
-            u32 const item_align = alignof(T);
-            u32 const item_size  = (sizeof(T) + (item_align - 1)) & ~(item_align - 1);
+            old_bytes = (old_bytes + page_size - 1) & ~(page_size - 1);
+            new_bytes = (new_bytes + page_size - 1) & ~(page_size - 1);
+            return new_bytes <= old_bytes || nvmem::commit((u8*)section + old_bytes, new_bytes - old_bytes);
+        }
+
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::setup(u32 initial_item_count, u32 maximum_item_count, s8 page_size_shift, ncommit::value_t commit_mode, numa_t const& numa)
+        {
+            m_baseptr = nullptr;
+
+            nvmem::initialize();
+            const s8 system_page_size_shift = nvmem::get_page_size_shift();
+            m_page_size_shift               = page_size_shift < system_page_size_shift ? system_page_size_shift : (page_size_shift > 30 ? 30 : page_size_shift);
+            m_page_max                      = s_number_of_pages(Stride, maximum_item_count, m_page_size_shift);
+            m_guard_pages                   = nvmem::get_guard_mode() ? 1 : 0;
 
-            const u64 maximum_address_range = maximum_item_count * sizeof(T);
-            void*     baseptr;
-            if (!nvmem::reserve(maximum_address_range, nvmem::nprotect::ReadWrite, baseptr))
+            // in guard mode the page after the last item page is never commited, indexing past the end faults
+            const u64             maximum_address_range = ((u64)m_page_max + m_guard_pages) << m_page_size_shift;
+            void*                 baseptr;
+            nvmem::npage::value_t page_kind;
+            if (!nvmem::reserve(maximum_address_range, nvmem::nprotect::ReadWrite, m_page_size_shift, numa, baseptr, page_kind))
                 return false;
 
-            const u32 page_size = nvmem::get_page_size();
+            // occupancy bitmap (1 bit per item), its summary (1 bit per bitmap word), the item count per page and the
+            // generation per item, in one reservation and commited together with the items
+            const u64 system_page_size = nvmem::get_page_size();
+            const u64 live_range       = (s_pool_live_bytes(max_capacity()) + system_page_size - 1) & ~(system_page_size - 1);
+            const u64 free_range       = (s_pool_free_bytes(max_capacity()) + system_page_size - 1) & ~(system_page_size - 1);
+            const u64 count_range      = (s_pool_count_bytes(m_page_max) + system_page_size - 1) & ~(system_page_size - 1);
+            const u64 gen_range        = (s_pool_generation_bytes(max_capacity()) + system_page_size - 1) & ~(system_page_size - 1);
+            void*     meta             = nullptr;
+            if (!nvmem::reserve(live_range + free_range + count_range + gen_range, nvmem::nprotect::ReadWrite, meta))
+            {
+                nvmem::release(baseptr, maximum_address_range);
+                return false;
+            }
 
-            m_baseptr          = (u8*)baseptr;
-            m_item_sizeof      = sizeof(T);
-            m_item_cap         = 0;
-            m_item_count       = initial_item_count;
-            u32 const page_max = (m_item_sizeof * maximum_item_count) / page_size;
+            m_live         = (u64*)meta;
+            m_free_words   = (u64*)((u8*)meta + live_range);
+            m_page_live    = (u32*)((u8*)meta + live_range + free_range);
+            m_generation   = (u32*)((u8*)meta + live_range + free_range + count_range);
+            m_meta_range   = live_range + free_range + count_range + gen_range;
+            m_meta_pages   = 0;
+            m_baseptr      = (u8*)baseptr;
+            m_page_kind    = page_kind;
+            m_commit_mode  = commit_mode;
+            m_item_cap     = 0;
+            m_item_count   = 0;
+            m_free_index   = 0;
+            m_free_hint    = 0;
+            m_page_count   = 0;
+            m_page_grow    = s_number_of_pages(Stride, 1, m_page_size_shift);
+            m_page_empty   = 0;
+            m_page_trimmed = 0;
+            m_trim_pages   = 0;
+            m_peak_count   = 0;
+            m_peak_pages   = 0;
+            m_trim_count   = 0;
+            m_alloc_count  = 0;
+            m_stats        = {0, 0, 0, 0};
 
-            u32 page_com = s_number_of_pages(m_item_sizeof, initial_item_count, page_size);
-            if (page_com > page_max)
+            u32 page_com = s_number_of_pages(Stride, initial_item_count, m_page_size_shift);
+            if (page_com > m_page_max)
             {
-                page_com = page_max;
+                page_com = m_page_max;
             }
 
             if (page_com > 0)
             {
-                if (!nvmem::commit(m_baseptr, (u64)page_size * page_com))
+                if (!commit_pages(0, page_com))
+                {
+                    nvmem::release(m_baseptr, maximum_address_range);
+                    nvmem::release(meta, m_meta_range);
+                    m_baseptr = nullptr;
+                    m_live    = nullptr;
                     return false;
+                }
 
-                m_item_cap = (page_com * nvmem::get_page_size()) / m_item_sizeof;
+                m_page_count = page_com;
+                m_page_empty = page_com;
+                m_peak_pages = page_com;
+                m_page_grow  = page_com > m_page_grow ? page_com : m_page_grow;
+                m_item_cap   = (u32)(((u64)page_com << m_page_size_shift) / Stride);
             }
 
             return true;
         }
 
-        template <typename T> bool pool_t<T>::teardown()
+        template <typename T, u32 Stride> void pool_t<T, Stride>::set_grow_size(u32 item_count)
+        {
+            m_page_grow = s_number_of_pages(Stride, item_count > 0 ? item_count : 1, m_page_size_shift);
+        }
+
+        template <typename T, u32 Stride> void pool_t<T, Stride>::set_trim_threshold(u32 item_count)
         {
-            const u32 page_size = nvmem::get_page_size();
-            u32 const page_max  = ((m_item_sizeof * m_item_cap) + page_size - 1) / page_size;
-            if (!nvmem::release(m_baseptr, page_max * page_size))
+            m_trim_pages = item_count > 0 ? s_number_of_pages(Stride, item_count, m_page_size_shift) : 0;
+        }
+
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::reserve(u32 item_count)
+        {
+            if (item_count <= m_item_cap)
+                return true;
+            const u32 num_pages = s_number_of_pages(Stride, item_count, m_page_size_shift);
+            if (num_pages > m_page_max)
+                return false;
+            return grow(num_pages - m_page_count);
+        }
+
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::commit_meta(u32 page_end)
+        {
+            if (page_end <= m_meta_pages)
+                return true;
+
+            const u64 system_page_size = nvmem::get_page_size();
+            const u64 old_items        = ((u64)m_meta_pages << m_page_size_shift) / Stride;
+            const u64 new_items        = ((u64)page_end << m_page_size_shift) / Stride;
+            if (!s_pool_commit_section(m_live, s_pool_live_bytes(old_items), s_pool_live_bytes(new_items), system_page_size))
+                return false;
+            if (!s_pool_commit_section(m_free_words, s_pool_free_bytes(old_items), s_pool_free_bytes(new_items), system_page_size))
                 return false;
+            if (!s_pool_commit_section(m_page_live, s_pool_count_bytes(m_meta_pages), s_pool_count_bytes(page_end), system_page_size))
+                return false;
+            if (!s_pool_commit_section(m_generation, s_pool_generation_bytes(old_items), s_pool_generation_bytes(new_items), system_page_size))
+                return false;
+            m_meta_pages = page_end;
             return true;
         }
 
-        template <typename T> u32 pool_t<T>::v_allocsize() const { return m_item_sizeof; }
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::commit_pages(u32 first_page, u32 num_pages)
+        {
+            if (!commit_meta(first_page + num_pages))
+                return false;
+
+            u8* const page_address = m_baseptr + ((u64)first_page << m_page_size_shift);
+            const u64 size         = (u64)num_pages << m_page_size_shift;
+            if (!nvmem::commit(page_address, size, m_stats))
+                return false;
+            return m_commit_mode != nvmem::ncommit::Populate || nvmem::populate(page_address, size);
+        }
 
-        template <typename T> void* pool_t<T>::v_allocate()
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::grow(u32 num_pages)
         {
-            if (m_free_head != 0xffffffff)
+            if (num_pages > (m_page_max - m_page_count))
+                num_pages = m_page_max - m_page_count;
+            if (num_pages == 0)
+                return false;
+
+            if (!commit_pages(m_page_count, num_pages))
+                return false;
+
+            for (u32 p = m_page_count; p < m_page_count + num_pages; ++p)
+                m_page_live[p] = 0;
+            m_page_count += num_pages;
+            m_page_empty += num_pages;
+            m_peak_pages = (m_page_count - m_page_trimmed) > m_peak_pages ? (m_page_count - m_page_trimmed) : m_peak_pages;
+            m_item_cap = (u32)(((u64)m_page_count << m_page_size_shift) / Stride);
+            return true;
+        }
+
+        // The pages that an item overlaps count it as in use, a page that was trimmed is commited again.
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::occupy_pages(u32 index)
+        {
+            const u64 begin = (u64)index * Stride;
+            const u32 first = (u32)(begin >> m_page_size_shift);
+            const u32 last  = (u32)((begin + Stride - 1) >> m_page_size_shift);
+            for (u32 p = first; p <= last; ++p)
+            {
+                if (m_page_live[p] == cPageTrimmed)
+                {
+                    if (!commit_pages(p, 1))
+                        return false;
+                    m_page_live[p] = 0;
+                    m_page_trimmed -= 1;
+                    m_page_empty += 1;
+                    m_peak_pages = (m_page_count - m_page_trimmed) > m_peak_pages ? (m_page_count - m_page_trimmed) : m_peak_pages;
+                }
+            }
+            for (u32 p = first; p <= last; ++p)
+            {
+                if (m_page_live[p]++ == 0)
+                    m_page_empty -= 1;
+            }
+            return true;
+        }
+
+        template <typename T, u32 Stride> void pool_t<T, Stride>::vacate_pages(u32 index)
+        {
+            const u64 begin = (u64)index * Stride;
+            const u32 first = (u32)(begin >> m_page_size_shift);
+            const u32 last  = (u32)((begin + Stride - 1) >> m_page_size_shift);
+            for (u32 p = first; p <= last; ++p)
             {
-                u32 const index = m_free_head;
-                u32*      p     = (u32*)v_idx2ptr(index);
-                m_free_head     = *p;
-                m_item_count++;
-                return p;
+                if (--m_page_live[p] == 0)
+                    m_page_empty += 1;
             }
+        }
+
+        // Set or clear the summary bit of a bitmap word, set when the word has a free item below m_free_index.
+        template <typename T, u32 Stride> void pool_t<T, Stride>::update_free_word(u32 word)
+        {
+            const u32 base = word << 6;
+            bool      free = false;
+            if (base < m_free_index)
+            {
+                const u32 count = m_free_index - base;
+                const u64 mask  = count >= 64 ? ~(u64)0 : (((u64)1 << count) - 1);
+                free            = (~m_live[word] & mask) != 0;
+            }
+            if (free)
+                m_free_words[word >> 6] |= (u64)1 << (word & 63);
             else
+                m_free_words[word >> 6] &= ~((u64)1 << (word & 63));
+        }
+
+        template <typename T, u32 Stride> u32 pool_t<T, Stride>::trim(u32 keep_pages)
+        {
+            u32 trimmed = 0;
+            u32 p       = 0;
+            while (p < m_page_count)
             {
-                if (m_free_index < m_item_cap)
+                if (m_page_live[p] != 0 || keep_pages > 0)
                 {
-                    u32 const index = m_free_index++;
-                    m_item_count++;
-                    return v_idx2ptr(index);
+                    keep_pages -= m_page_live[p] == 0 ? 1 : 0;
+                    ++p;
+                    continue;
                 }
+
+                // decommit a run of empty pages in one go
+                u32 end = p + 1;
+                while (end < m_page_count && m_page_live[end] == 0)
+                    ++end;
+                if (nvmem::decommit(m_baseptr + ((u64)p << m_page_size_shift), (u64)(end - p) << m_page_size_shift, m_stats))
+                {
+                    for (u32 i = p; i < end; ++i)
+                        m_page_live[i] = cPageTrimmed;
+                    m_page_trimmed += end - p;
+                    m_page_empty -= end - p;
+                    trimmed += end - p;
+                }
+                p = end;
+            }
+            m_trim_count += trimmed;
+
+            // trimmed pages at the end lower the capacity, items at and above it were never used or are free
+            while (m_page_count > 0 && m_page_live[m_page_count - 1] == cPageTrimmed)
+            {
+                m_page_count -= 1;
+                m_page_trimmed -= 1;
+                m_page_live[m_page_count] = 0;
+            }
+            m_item_cap = (u32)(((u64)m_page_count << m_page_size_shift) / Stride);
+            if (m_free_index > m_item_cap)
+            {
+                const u32 word_end = (m_free_index + 63) >> 6;
+                m_free_index       = m_item_cap;
+                for (u32 w = m_free_index >> 6; w < word_end; ++w)
+                    update_free_word(w);
             }
-            return nullptr;
+            return trimmed;
         }
 
-        template <typename T> void pool_t<T>::v_deallocate(void* ptr)
+        template <typename T, u32 Stride> bool pool_t<T, Stride>::teardown()
         {
-            const u32 index = v_ptr2idx(ptr);
-            *(u32*)ptr      = m_free_head;
-            m_free_head     = index;
+            if (m_baseptr == nullptr)
+                return true;
+            if (nvmem::reclaim_running())
+            {
+                nvmem::release_async(m_baseptr, ((u64)m_page_max + m_guard_pages) << m_page_size_shift);
+                nvmem::release_async(m_live, m_meta_range);
+            }
+            else if (!nvmem::release(m_baseptr, ((u64)m_page_max + m_guard_pages) << m_page_size_shift) || !nvmem::release(m_live, m_meta_range))
+            {
+                return false;
+            }
+            m_baseptr      = nullptr;
+            m_live         = nullptr;
+            m_free_words   = nullptr;
+            m_page_live    = nullptr;
+            m_generation   = nullptr;
+            m_meta_range   = 0;
+            m_meta_pages   = 0;
+            m_item_cap     = 0;
+            m_item_count   = 0;
+            m_free_index   = 0;
+            m_free_hint    = 0;
+            m_page_count   = 0;
+            m_page_max     = 0;
+            m_guard_pages  = 0;
+            m_page_grow    = 1;
+            m_page_empty   = 0;
+            m_page_trimmed = 0;
+            return true;
+        }
+
+        template <typename T, u32 Stride> u32 pool_t<T, Stride>::v_allocsize() const { return Stride; }
+
+        // The lowest free item is used, found through the summary of the occupancy bitmap, when there is no free item
+        // below m_free_index the next never used item is taken.
+        template <typename T, u32 Stride> inline u32 pool_t<T, Stride>::allocate_index()
+        {
+            u32 index;
+            if (m_item_count < m_free_index)
+            {
+                u32 s = m_free_hint;
+                while (m_free_words[s] == 0)
+                    ++s;
+                m_free_hint = s;
+                const u32 w = (s << 6) + s_pool_lowest_bit(m_free_words[s]);
+                index       = (w << 6) + s_pool_lowest_bit(~m_live[w]);
+            }
+            else if (m_free_index < m_item_cap || (grow(m_page_grow) && m_free_index < m_item_cap))
+            {
+                index = m_free_index;
+            }
+            else
+            {
+                return cInvalidIndex;
+            }
+
+            if (!occupy_pages(index))
+                return cInvalidIndex;
+
+            m_live[index >> 6] |= (u64)1 << (index & 63);
+            if (index == m_free_index)
+                m_free_index++;
+            else
+                update_free_word(index >> 6);
+
+            m_item_count++;
+            m_alloc_count++;
+            m_peak_count = m_item_count > m_peak_count ? m_item_count : m_peak_count;
+            return index;
+        }
+
+        template <typename T, u32 Stride> inline void pool_t<T, Stride>::deallocate_index(u32 index)
+        {
+            const u32 word = index >> 6;
+            m_live[word] &= ~((u64)1 << (index & 63));
+            m_free_words[word >> 6] |= (u64)1 << (word & 63);
+            m_free_hint = (word >> 6) < m_free_hint ? (word >> 6) : m_free_hint;
+            m_generation[index]++;
             m_item_count--;
+
+            vacate_pages(index);
+            if (m_trim_pages != 0 && m_page_empty > (m_trim_pages + m_page_grow))
+                trim(m_page_grow);
+        }
+
+        // Free items are taken a bitmap word (up to 64 items) at a time and never used items as one run.
+        template <typename T, u32 Stride> u32 pool_t<T, Stride>::allocate_n(T** items, u32 count)
+        {
+            u32 done = 0;
+            while (done < count)
+            {
+                if (m_item_count < m_free_index)
+                {
+                    u32 s = m_free_hint;
+                    while (m_free_words[s] == 0)
+                        ++s;
+                    m_free_hint   = s;
+                    const u32 w   = (s << 6) + s_pool_lowest_bit(m_free_words[s]);
+                    const u32 end = m_free_index - (w << 6);
+                    u64       bits = ~m_live[w] & (end >= 64 ? ~(u64)0 : (((u64)1 << end) - 1));
+                    u64       taken = 0;
+                    u32       n     = 0;
+                    while (bits != 0 && done < count)
+                    {
+                        const u32 index = (w << 6) + s_pool_lowest_bit(bits);
+                        if (!occupy_pages(index))
+                            break;
+                        taken |= bits & (~bits + 1);
+                        bits &= bits - 1;
+                        items[done++] = ptr_at(index);
+                        n += 1;
+                    }
+                    m_live[w] |= taken;
+                    m_item_count += n;
+                    update_free_word(w);
+                    if (bits != 0 && done < count)
+                        break; // commit failed
+                }
+                else
+                {
+                    if (m_free_index >= m_item_cap && !(grow(m_page_grow) && m_free_index < m_item_cap))
+                        break;
+                    const u32 room = m_item_cap - m_free_index;
+                    const u32 run  = (count - done) < room ? (count - done) : room;
+                    u32       n    = 0;
+                    while (n < run && occupy_pages(m_free_index + n))
+                    {
+                        const u32 index = m_free_index + n;
+                        m_live[index >> 6] |= (u64)1 << (index & 63);
+                        items[done++] = ptr_at(index);
+                        n += 1;
+                    }
+                    m_free_index += n;
+                    m_item_count += n;
+                    if (n < run)
+                        break; // commit failed
+                }
+            }
+
+            m_alloc_count += done;
+            m_peak_count = m_item_count > m_peak_count ? m_item_count : m_peak_count;
+            return done;
+        }
+
+        // Items in the same bitmap word are released with one update of the bitmap and its summary.
+        template <typename T, u32 Stride> void pool_t<T, Stride>::deallocate_n(T* const* items, u32 count)
+        {
+            u32 word = cInvalidIndex;
+            u64 mask = 0;
+            for (u32 i = 0; i < count; ++i)
+            {
+                const u32 index = idx_of(items[i]);
+                if ((index >> 6) != word)
+                {
+                    if (mask != 0)
+                    {
+                        m_live[word] &= ~mask;
+                        m_free_words[word >> 6] |= (u64)1 << (word & 63);
+                        m_free_hint = (word >> 6) < m_free_hint ? (word >> 6) : m_free_hint;
+                    }
+                    word = index >> 6;
+                    mask = 0;
+                }
+                mask |= (u64)1 << (index & 63);
+                m_generation[index]++;
+                vacate_pages(index);
+            }
+            if (mask != 0)
+            {
+                m_live[word] &= ~mask;
+                m_free_words[word >> 6] |= (u64)1 << (word & 63);
+                m_free_hint = (word >> 6) < m_free_hint ? (word >> 6) : m_free_hint;
+            }
+            m_item_count -= count;
+
+            if (m_trim_pages != 0 && m_page_empty > (m_trim_pages + m_page_grow))
+                trim(m_page_grow);
+        }
+
+        template <typename T, u32 Stride> void* pool_t<T, Stride>::v_allocate()
+        {
+            const u32 index = allocate_index();
+            return index != cInvalidIndex ? ptr_at(index) : nullptr;
+        }
+
+        template <typename T, u32 Stride> void pool_t<T, Stride>::get_stats(pool_stats_t& stats) const
+        {
+            stats.alloc_count      = m_alloc_count;
+            stats.item_count       = m_item_count;
+            stats.peak_item_count  = m_peak_count;
+            stats.page_count       = m_page_count - m_page_trimmed;
+            stats.peak_page_count  = m_peak_pages;
+            stats.empty_page_count = m_page_empty;
+            stats.trim_page_count  = m_trim_count;
+            stats.page_max         = m_page_max;
+            stats.page_size_shift  = m_page_size_shift;
+            stats.commit_stats     = m_stats;
+        }
+
+        template <typename T, u32 Stride> void pool_t<T, Stride>::v_deallocate(void* ptr) { deallocate_index(idx_of((T const*)ptr)); }
+
+        template <typename T, u32 Stride> template <typename F> void pool_t<T, Stride>::for_each_live(F fn)
+        {
+            const u32 words = (m_free_index + 63) >> 6;
+            for (u32 w = 0; w < words; ++w)
+            {
+                u64       bits = m_live[w];
+                const u32 base = w << 6;
+                if (bits == ~(u64)0)
+                {
+                    for (u32 i = base; i < base + 64; ++i)
+                        fn(ptr_at(i), i);
+                }
+                else
+                {
+                    while (bits != 0)
+                    {
+                        const u32 i = base + s_pool_lowest_bit(bits);
+                        bits &= bits - 1;
+                        fn(ptr_at(i), i);
+                    }
+                }
+            }
+        }
+
+        template <typename T, u32 Stride> u32 pool_t<T, Stride>::find_live(u32 index) const
+        {
+            if (index >= m_free_index)
+                return cInvalidIndex;
+            const u32 words = (m_free_index + 63) >> 6;
+            u32       w     = index >> 6;
+            u64       bits  = m_live[w] & (~(u64)0 << (index & 63));
+            while (bits == 0)
+            {
+                if (++w >= words)
+                    return cInvalidIndex;
+                bits = m_live[w];
+            }
+            return (w << 6) + s_pool_lowest_bit(bits);
         }
 
-        template <typename T> void* pool_t<T>::v_idx2ptr(u32 index) { return (void*)((u8*)m_baseptr + index * m_item_sizeof); }
-        template <typename T> u32   pool_t<T>::v_ptr2idx(void const* ptr) const { return (u32)(((u8*)ptr - (u8*)m_baseptr) / m_item_sizeof); }
+        template <typename T, u32 Stride> void* pool_t<T, Stride>::v_idx2ptr(u32 index) { return ptr_at(index); }
+        template <typename T, u32 Stride> u32   pool_t<T, Stride>::v_ptr2idx(void const* ptr) const { return idx_of((T const*)ptr); }
     } // namespace nvmem
 } // namespace ncore
@@ -4,8 +4,16 @@
 
 #include "cunittest/cunittest.h"
 
+#include "cvmem/c_virtual_memory.h"
 #include "cvmem/c_virtual_arena.h"
 
+#include <cstdio>
+
+#if !defined(TARGET_PC)
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
+
 using namespace ncore;
 
 UNITTEST_SUITE_BEGIN(virtual_arena)
@@ -30,8 +38,8 @@ UNITTEST_SUITE_BEGIN(virtual_arena)
             ASSERT(arena != nullptr);
             ASSERT(ArenaIsValid(arena));
             ASSERT(ArenaPos(arena) == 0);
-            ASSERT(arena->CapacityReserved >= 1024 << ARENA_DEFAULT_PAGESIZE_SHIFT);
-            ASSERT(arena->CapacityCommited >= 256 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena->CapacityReserved >= 1024); // (unit=pages)
+            ASSERT(arena->CapacityCommited >= 256);  // (unit=pages)
             ArenaRelease(arena);
         }
 
@@ -56,6 +64,610 @@ UNITTEST_SUITE_BEGIN(virtual_arena)
 
             ArenaRelease(arena);
         }
+
+        UNITTEST_TEST(many_arenas)
+        {
+            // More arenas than the initial number of slots, the slot array grows
+            static arena_t* arenas[100];
+            for (s32 i = 0; i < 100; ++i)
+            {
+                arenas[i] = ArenaAlloc(16 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+                ASSERT(arenas[i] != nullptr);
+                ASSERT(ArenaIsValid(arenas[i]));
+            }
+            for (s32 i = 0; i < 100; ++i)
+                ArenaRelease(arenas[i]);
+
+            // Released slots are reused
+            arena_t* arena = ArenaAlloc(16 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena == arenas[99]);
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(policy)
+        {
+            arena_t* arena = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+
+            arena_policy_t policy;
+            policy.MinCommitBytes  = 16 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            policy.GrowthPercent   = 100;
+            policy.KeepCommitBytes = 4 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            policy.DecommitDelay   = 4;
+            ArenaSetPolicy(arena, policy);
+
+            arena_policy_t current;
+            ArenaGetPolicy(arena, current);
+            ASSERT(current.MinCommitBytes == policy.MinCommitBytes);
+            ASSERT(current.DecommitDelay == 4);
+
+            // Growing commits at least the minimum chunk, then doubles
+            ArenaPush(arena, 2 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena->CapacityCommited == 17);
+            ArenaPush(arena, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena->CapacityCommited == 34);
+
+            // A steady reset-and-refill loop doesn't decommit
+            for (s32 i = 0; i < 16; ++i)
+            {
+                ArenaClear(arena);
+                ArenaPush(arena, 20 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+                ASSERT(arena->CapacityCommited == 34);
+            }
+
+            // Usage drops, after the decommit delay the arena shrinks to what the peak usage would grow to
+            for (s32 i = 0; i < 4; ++i)
+            {
+                ArenaClear(arena);
+                ASSERT(arena->CapacityCommited == 34);
+            }
+            for (s32 i = 0; i < 4; ++i)
+            {
+                ArenaPush(arena, 5 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+                ArenaClear(arena);
+            }
+            ASSERT(arena->CapacityCommited == 20);
+
+            // But never below the low-water mark
+            for (s32 i = 0; i < 4; ++i)
+                ArenaClear(arena);
+            ASSERT(arena->CapacityCommited == 4);
+
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(push_aligned)
+        {
+            arena_t* arena = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ArenaPush(arena, 3);
+            u8* ptr = (u8*)ArenaPushAligned(arena, 16, 64);
+            ASSERT(ptr == arena->Mem + 64);
+            ASSERT(ArenaPos(arena) == 80);
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(stats)
+        {
+            arena_t* arena = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ArenaSetName(arena, "stats");
+
+            ArenaPush(arena, 3 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ArenaPop(arena, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ArenaPush(arena, 100);
+
+            arena_stats_t stats;
+            ArenaGetStats(arena, stats);
+            ASSERT(stats.Pos == (2 << ARENA_DEFAULT_PAGESIZE_SHIFT) + 100);
+            ASSERT(stats.BytesPushed == (3 << ARENA_DEFAULT_PAGESIZE_SHIFT) + 100);
+            ASSERT(stats.PeakPos == (3 << ARENA_DEFAULT_PAGESIZE_SHIFT));
+            ASSERT(stats.PeakCommitedBytes == (3 << ARENA_DEFAULT_PAGESIZE_SHIFT));
+            ASSERT(stats.CommitCount == 2);
+            ASSERT(stats.DecommitCount == 0);
+
+            ArenaClear(arena);
+            ArenaGetStats(arena, stats);
+            ASSERT(stats.DecommitCount == 1);
+            ASSERT(stats.CommitedBytes == 0);
+
+            // The registry snapshot contains this arena
+            arena_stats_t snapshot[64];
+            const s32     count = ArenasSnapshot(snapshot, 64);
+            bool          found = false;
+            for (s32 i = 0; i < count && i < 64; ++i)
+                found = found || (snapshot[i].Name == ArenaGetName(arena));
+            ASSERT(found);
+
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(push_concurrent)
+        {
+            arena_t* arena = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena != nullptr);
+
+            // Sizes are rounded up to the minimum alignment of the arena
+            u8* a = (u8*)ArenaPushConcurrent(arena, 3);
+            u8* b = (u8*)ArenaPushConcurrent(arena, 8);
+            ASSERT(a == arena->Mem);
+            ASSERT(b == a + (1 << ARENA_DEFAULT_ALIGNMENT_SHIFT));
+
+            // Crossing the commited range grows it
+            u8* c = (u8*)ArenaPushConcurrent(arena, 3 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(c != nullptr);
+            ASSERT(arena->CapacityCommited == 4);
+            nmem::memset(c, 0xCD, 3 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+
+            u8* d = (u8*)ArenaPushConcurrentAligned(arena, 64, 256);
+            ASSERT(d != nullptr);
+            ASSERT(((ptr_t)d & 255) == 0);
+
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(scratch)
+        {
+            arena_t* result = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+
+            scratch_t outer = ScratchBegin();
+            ASSERT(outer.Arena != nullptr);
+            ASSERT(outer.Arena != result);
+            ArenaPush(outer.Arena, 100);
+
+            // A nested scope that produces its output in the outer scratch arena gets the other scratch arena
+            scratch_t inner = ScratchBegin(outer.Arena);
+            ASSERT(inner.Arena != nullptr);
+            ASSERT(inner.Arena != outer.Arena);
+            ArenaPush(inner.Arena, 200);
+            ScratchEnd(inner);
+            ASSERT(ArenaPos(inner.Arena) == inner.Pos);
+
+            // Without conflicts the first scratch arena is handed out again, positions are restored on end
+            scratch_t again = ScratchBegin(&result, 1);
+            ASSERT(again.Arena == outer.Arena);
+            ASSERT(again.Pos == outer.Pos + 100);
+            ScratchEnd(again);
+            ScratchEnd(outer);
+            ASSERT(ArenaPos(outer.Arena) == outer.Pos);
+
+            ArenaRelease(result);
+        }
+
+        UNITTEST_TEST(prefault)
+        {
+            arena_t* arena = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 4 << ARENA_DEFAULT_PAGESIZE_SHIFT, ARENA_DEFAULT_ALIGNMENT_SHIFT, ARENA_DEFAULT_PAGESIZE_SHIFT, ARENA_FLAG_PREFAULT);
+            ASSERT(arena != nullptr);
+            ASSERT(arena->Flags == ARENA_FLAG_PREFAULT);
+            ASSERT(arena->CapacityCommited == 4);
+
+            // Growing populates the new pages as well
+            u8* ptr = (u8*)ArenaPush(arena, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(ptr != nullptr);
+            ASSERT(arena->CapacityCommited == 16);
+            ASSERT(ptr[0] == 0 && ptr[(16 << ARENA_DEFAULT_PAGESIZE_SHIFT) - 1] == 0);
+
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(numa)
+        {
+            nvmem::numa_t interleave = {nvmem::nnuma::Interleave, 0};
+            arena_t*      arena      = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 4 << ARENA_DEFAULT_PAGESIZE_SHIFT, interleave);
+            ASSERT(arena != nullptr);
+            u8* ptr = (u8*)ArenaPush(arena, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(ptr != nullptr);
+            ptr[0] = 1;
+
+            // Bind to node 0, which always exists, the backed pages are moved
+            nvmem::numa_t bind = {nvmem::nnuma::Bind, 1};
+            ASSERT(ArenaSetNuma(arena, bind));
+            ASSERT(ptr[0] == 1);
+            ASSERT(nvmem::query_node(ptr) == 0 || nvmem::query_node(ptr) == -1);
+
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(huge_pages)
+        {
+            // Falls back to normal pages when huge pages are not available, but still uses 2 MiB commit granularity
+            arena_t* arena = ArenaAlloc(64 << 20, 4 << 20, ARENA_DEFAULT_ALIGNMENT_SHIFT, ARENA_HUGE_PAGESIZE_SHIFT);
+            ASSERT(arena != nullptr);
+            ASSERT(ArenaIsValid(arena));
+            ASSERT(arena->PageSizeShift == ARENA_HUGE_PAGESIZE_SHIFT);
+            ASSERT(arena->PageKind >= nvmem::npage::Normal && arena->PageKind <= nvmem::npage::Huge);
+            ASSERT(((ptr_t)arena->Mem & ((1 << ARENA_HUGE_PAGESIZE_SHIFT) - 1)) == 0);
+            ASSERT(arena->CapacityReserved == 32); // (unit=pages)
+            ASSERT(arena->CapacityCommited == 2);  // (unit=pages)
+
+            nmem::memset(ArenaPush(arena, 6 << 20), 0xCD, 6 << 20);
+            ASSERT(arena->CapacityCommited == 3);
+
+            ArenaRelease(arena);
+        }
+
+        struct dirty_runs_t
+        {
+            s32   Count;
+            int_t Offset[8];
+            int_t Size[8];
+        };
+
+        static void CollectDirty(const arena_t*, int_t offset, int_t size, void* user)
+        {
+            dirty_runs_t* runs = (dirty_runs_t*)user;
+            if (runs->Count < 8)
+            {
+                runs->Offset[runs->Count] = offset;
+                runs->Size[runs->Count]   = size;
+            }
+            runs->Count += 1;
+        }
+
+        UNITTEST_TEST(dirty_tracking)
+        {
+            const int_t page  = (int_t)1 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            arena_t*    arena = ArenaAlloc(256 * page, 8 * page);
+            ASSERT(arena != nullptr);
+            u8* mem = (u8*)ArenaPush(arena, 8 * page);
+            ASSERT(ArenaDirtyTrack(arena));
+            ASSERT((arena->Flags & ARENA_FLAG_DIRTY) != 0);
+
+            // The first checkpoint reports everything that is commited
+            dirty_runs_t runs = {};
+            ASSERT(ArenaDirtyCheckpoint(arena, CollectDirty, &runs) == 8 * page);
+            ASSERT(runs.Count == 1 && runs.Offset[0] == 0 && runs.Size[0] == 8 * page);
+
+            // Nothing was stored to since
+            runs = {};
+            ASSERT(ArenaDirtyCheckpoint(arena, CollectDirty, &runs) == 0);
+            ASSERT(runs.Count == 0);
+
+            // Stores mark their pages, neighbouring pages form one run
+            mem[1 * page + 10] = 1;
+            mem[2 * page]      = 2;
+            mem[5 * page + 99] = 3;
+            ASSERT(mem[3 * page] == 0); // reads don't
+            runs = {};
+            ASSERT(ArenaDirtyCheckpoint(arena, CollectDirty, &runs) == 3 * page);
+            ASSERT(runs.Count == 2);
+            ASSERT(runs.Offset[0] == 1 * page && runs.Size[0] == 2 * page);
+            ASSERT(runs.Offset[1] == 5 * page && runs.Size[1] == 1 * page);
+            ASSERT(mem[1 * page + 10] == 1 && mem[2 * page] == 2 && mem[5 * page + 99] == 3);
+
+            // Pages commited by a push are dirty
+            u8* more = (u8*)ArenaPush(arena, 100 * page);
+            ASSERT(more == mem + 8 * page);
+            more[0] = 4;
+            mem[0]  = 5;
+            runs    = {};
+            ASSERT(ArenaDirtyCheckpoint(arena, CollectDirty, &runs) == page + 100 * page);
+            ASSERT(runs.Count == 2 && runs.Offset[1] == 8 * page);
+
+            // After a shrink and growing again the pages are dirty again
+            ArenaPopTo(arena, 8 * page);
+            ArenaCommit(arena, 8 * page);
+            ArenaPush(arena, page);
+            runs = {};
+            ASSERT(ArenaDirtyCheckpoint(arena, CollectDirty, &runs) == page);
+            ASSERT(runs.Count == 1 && runs.Offset[0] == 8 * page);
+
+            ArenaDirtyUntrack(arena);
+            ASSERT((arena->Flags & ARENA_FLAG_DIRTY) == 0);
+            mem[3 * page] = 6;
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(double_ended)
+        {
+            const int_t page  = (int_t)1 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            arena_t*    arena = ArenaAlloc(16 * page, 2 * page, ARENA_DEFAULT_ALIGNMENT_SHIFT, ARENA_DEFAULT_PAGESIZE_SHIFT, ARENA_FLAG_DOUBLE_ENDED);
+            ASSERT(arena != nullptr);
+            u8* const end = arena->Mem + 16 * page;
+
+            u8* front = (u8*)ArenaPush(arena, 4 * page);
+            ASSERT(front == arena->Mem);
+            front[4 * page - 1] = 1;
+            ASSERT(ArenaPosBack(arena) == 0);
+
+            // The back stack grows down from the end of the reservation, pushes are rounded up to the alignment
+            u8* back = (u8*)ArenaPushBack(arena, 100);
+            ASSERT(back == end - 104);
+            ASSERT(ArenaPosBack(arena) == 104);
+            ASSERT(arena->CapacityCommitedBack == 1);
+            back[0] = 2;
+
+            const int_t mark = ArenaPosBack(arena);
+            u8*         temp = (u8*)ArenaPushBack(arena, 3 * page);
+            ASSERT(temp == end - 104 - 3 * page);
+            temp[0]            = 3;
+            temp[3 * page - 1] = 4;
+            ArenaPopBackTo(arena, mark);
+            ASSERT(ArenaPosBack(arena) == mark);
+
+            // When the stacks would meet a push fails without touching either stack
+            ASSERT(ArenaPush(arena, 12 * page) == nullptr);
+            ASSERT(ArenaPushBack(arena, 12 * page) == nullptr);
+            ASSERT(ArenaPos(arena) == 4 * page && ArenaPosBack(arena) == mark);
+            ASSERT(front[4 * page - 1] == 1 && back[0] == 2);
+
+            // The pages that the back stack commited but doesn't use are taken over by the front stack
+            ASSERT(arena->CapacityCommitedBack == 4);
+            ASSERT(ArenaPush(arena, 11 * page) != nullptr);
+            ASSERT(arena->CapacityCommited == 15 && arena->CapacityCommitedBack == 1);
+            ASSERT(back[0] == 2);
+
+            arena_stats_t stats;
+            ArenaGetStats(arena, stats);
+            ASSERT(stats.CommitedBytes == (int_t)(arena->CapacityCommited + arena->CapacityCommitedBack) * page);
+
+            // Clearing the back decommits it, the front can then grow up to the end
+            ArenaClearBack(arena);
+            ASSERT(ArenaPosBack(arena) == 0 && arena->CapacityCommitedBack == 0);
+            u8* last = (u8*)ArenaPush(arena, 16 * page - ArenaPos(arena));
+            ASSERT(last != nullptr);
+            last[0] = 5;
+            ASSERT(ArenaPushBack(arena, 8) == nullptr);
+
+            ArenaClear(arena);
+            ASSERT(ArenaPushBack(arena, 8) == end - 8);
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(double_ended_commited)
+        {
+            // Everything is commited for the front stack, the back stack takes the pages it needs from it
+            const int_t page  = (int_t)1 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            arena_t*    arena = ArenaAlloc(64 * page, 64 * page, ARENA_DEFAULT_ALIGNMENT_SHIFT, ARENA_DEFAULT_PAGESIZE_SHIFT, ARENA_FLAG_DOUBLE_ENDED);
+            ASSERT(arena != nullptr && arena->CapacityCommited == 64);
+
+            arena_policy_t policy = {4 * page, 50, 0, 0};
+            ArenaSetPolicy(arena, policy);
+
+            // Push from both ends until the stacks meet
+            s32 frontCount = 0, backCount = 0;
+            for (bool pushed = true; pushed;)
+            {
+                u8* front = (u8*)ArenaPush(arena, page - 16);
+                u8* back  = (u8*)ArenaPushBack(arena, page + 16);
+                if (front != nullptr)
+                    front[0] = (u8)++frontCount;
+                if (back != nullptr)
+                    back[0] = (u8)++backCount;
+                pushed = front != nullptr || back != nullptr;
+                ASSERT(arena->CapacityCommited + arena->CapacityCommitedBack <= arena->CapacityReserved);
+            }
+            ASSERT(frontCount > 0 && backCount > 0);
+            const s32 frontPages = (s32)((ArenaPos(arena) + page - 1) / page);
+            const s32 backPages  = (s32)((ArenaPosBack(arena) + page - 1) / page);
+            ASSERT(frontPages + backPages == 64);
+
+            // Everything that was pushed is still there
+            bool same = true;
+            for (s32 i = 0; i < frontCount; ++i)
+                same = same && arena->Mem[i * (page - 16)] == (u8)(i + 1);
+            for (s32 i = 0; i < backCount; ++i)
+                same = same && arena->Mem[64 * page - (i + 1) * (page + 16)] == (u8)(i + 1);
+            ASSERT(same);
+
+            ArenaRelease(arena);
+        }
+
+#if !defined(TARGET_PC)
+        UNITTEST_TEST(file_backed)
+        {
+            const char* path = "test_virtual_arena_file.bin";
+            std::remove(path);
+
+            arena_t* arena = ArenaAllocFile(path, 1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 4 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena != nullptr);
+            ASSERT((arena->Flags & ARENA_FLAG_FILE) != 0);
+            ASSERT(ArenaFileBase(arena) == arena->Mem);
+
+            // Pushing beyond the initial size grows the file
+            const s32 count  = 64 * 1024;
+            u32*      values = (u32*)ArenaPush(arena, count * sizeof(u32));
+            ASSERT(values != nullptr);
+            for (s32 i = 0; i < count; ++i)
+                values[i] = (u32)i * 3;
+            const int_t pos  = ArenaPos(arena);
+            u8* const   base = arena->Mem;
+            ASSERT(ArenaFlush(arena));
+            ArenaRelease(arena);
+
+            // Reopened with the position and the content, the reserved size of the file is kept
+            arena = ArenaAllocFile(path, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT, 0);
+            ASSERT(arena != nullptr);
+            ASSERT(ArenaPos(arena) == pos);
+            ASSERT(ArenaFileBase(arena) == base);
+            ASSERT(arena->CapacityReserved >= 1024);
+            values = (u32*)arena->Mem;
+            bool same = true;
+            for (s32 i = 0; i < count; ++i)
+                same = same && values[i] == (u32)i * 3;
+            ASSERT(same);
+
+            // Opened a second time the base is taken, the mapping is relocated and shows the same file
+            arena_t* other = ArenaAllocFile(path, 1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 0);
+            ASSERT(other != nullptr);
+            ASSERT(other->Mem != arena->Mem);
+            ASSERT(ArenaFileBase(other) == base);
+            ASSERT(((u32*)other->Mem)[count - 1] == (u32)(count - 1) * 3);
+            ArenaRelease(other);
+
+            // Release records the position without a flush, clearing shrinks the file
+            ArenaPush(arena, 100);
+            ArenaRelease(arena);
+            arena = ArenaAllocFile(path, 1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 0);
+            ASSERT(arena != nullptr);
+            ASSERT(ArenaPos(arena) == pos + 100);
+            ArenaClear(arena);
+            ASSERT(arena->CapacityCommited == 0);
+            ArenaRelease(arena);
+
+            std::remove(path);
+        }
+
+        UNITTEST_TEST(snapshot)
+        {
+            arena_t* arena = ArenaAllocFile(nullptr, 1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 4 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(arena != nullptr);
+
+            const s32 count  = 16 * 1024;
+            u32*      values = (u32*)ArenaPush(arena, count * sizeof(u32));
+            for (s32 i = 0; i < count; ++i)
+                values[i] = (u32)i;
+            const int_t pos      = ArenaPos(arena);
+            const s32   commited = arena->CapacityCommited;
+            ASSERT(ArenaSnapshot(arena));
+
+            // Changes in place and pushes that grow the arena are undone
+            values[0]         = 100;
+            values[count - 1] = 200;
+            u8* more          = (u8*)ArenaPush(arena, 64 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            ASSERT(more != nullptr);
+            more[0] = 1;
+            ASSERT(ArenaRestore(arena));
+            ASSERT(ArenaPos(arena) == pos);
+            ASSERT(arena->CapacityCommited == commited);
+            ASSERT(values[0] == 0 && values[count - 1] == (u32)(count - 1));
+
+            // The snapshot stays, it can be restored again
+            values[1] = 300;
+            ArenaPop(arena, 1024);
+            ASSERT(ArenaRestore(arena));
+            ASSERT(ArenaPos(arena) == pos && values[1] == 1);
+
+            // A second snapshot keeps the changes made since the first
+            values[2] = 400;
+            ASSERT(ArenaSnapshot(arena));
+            values[2] = 500;
+            values[3] = 600;
+            ASSERT(ArenaRestore(arena));
+            ASSERT(values[2] == 400 && values[3] == 3);
+
+            // Dropping the snapshot keeps the changes
+            values[4] = 700;
+            ASSERT(ArenaSnapshotDrop(arena));
+            ASSERT(values[2] == 400 && values[4] == 700);
+            values[5] = 800;
+            ASSERT(values[5] == 800);
+
+            ArenaRelease(arena);
+        }
+
+        // @returns true when a store to `address` crashes, the store is done in a child process (which exits with
+        // an error instead of a signal under a sanitizer)
+        static bool StoreFaults(void* address)
+        {
+            const pid_t pid = fork();
+            if (pid == 0)
+            {
+                *(volatile u8*)address = 1;
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+            return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+
+        UNITTEST_TEST(guard)
+        {
+            const int_t page  = (int_t)1 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            arena_t*    arena = ArenaAlloc(64 * page, 16 * page, ARENA_DEFAULT_ALIGNMENT_SHIFT, ARENA_DEFAULT_PAGESIZE_SHIFT, ARENA_FLAG_GUARD);
+            ASSERT(arena != nullptr);
+            ASSERT(arena->CapacityCommited == 0);
+            ASSERT(ArenaIsValid(arena));
+
+            // Only the pages in use are commited
+            u8* small = (u8*)ArenaPush(arena, 100);
+            ASSERT(small != nullptr);
+            small[99] = 1;
+            ASSERT(arena->CapacityCommited == 1);
+            ASSERT(StoreFaults(small + page));
+
+            // A large push ends against a guard page
+            const int_t mark  = ArenaPos(arena);
+            u8*         large = (u8*)ArenaPush(arena, 2 * page + 8);
+            ASSERT(large != nullptr);
+            large[0]            = 1;
+            large[2 * page + 7] = 1;
+            ASSERT(StoreFaults(large + 2 * page + 8));
+            ASSERT((ArenaPos(arena) & (page - 1)) == 0);
+            u8* aligned = (u8*)ArenaPushAligned(arena, page, 64);
+            ASSERT(aligned != nullptr && ((ptr_t)aligned & 63) == 0);
+            ASSERT(StoreFaults(aligned + page));
+
+            // Blocks of an odd size keep the minimum alignment of the arena, the guard page then follows within it
+            const int_t minAlignment = (int_t)1 << ARENA_DEFAULT_ALIGNMENT_SHIFT;
+            for (int_t size = page + 1; size < page + 2 * minAlignment; size += 3)
+            {
+                u8* odd = (u8*)ArenaPush(arena, size);
+                ASSERT(odd != nullptr && ((ptr_t)odd & (minAlignment - 1)) == 0);
+                odd[size - 1] = 1;
+                ASSERT(StoreFaults(odd + ((size + minAlignment - 1) & ~(minAlignment - 1))));
+            }
+
+            // A large push after a small one doesn't overlap it
+            u8* tiny = (u8*)ArenaPush(arena, 3);
+            u8* wide = (u8*)ArenaPush(arena, 2 * page - 3);
+            ASSERT(tiny != nullptr && wide != nullptr);
+            ASSERT(wide >= tiny + 3);
+            tiny[2]            = 1;
+            wide[0]            = 2;
+            wide[2 * page - 4] = 2;
+            ASSERT(tiny[2] == 1);
+            ASSERT(StoreFaults((u8*)(((ptr_t)(wide + 2 * page - 3) + page - 1) & ~(ptr_t)(page - 1))));
+
+            // Popped pages are decommited and stale pointers fault
+            ArenaPopTo(arena, mark);
+            ASSERT(arena->CapacityCommited == 1);
+            ASSERT(StoreFaults(large + page));
+            ASSERT(small[99] == 1);
+
+            // The last push of the reservation is guarded by the page after it
+            ArenaClear(arena);
+            ASSERT(arena->CapacityCommited == 0);
+            ASSERT(ArenaIsValid(arena));
+            u8* full = (u8*)ArenaPush(arena, 64 * page);
+            ASSERT(full != nullptr);
+            full[64 * page - 1] = 1;
+            ASSERT(StoreFaults(full + 64 * page));
+
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(guard_mode)
+        {
+            nvmem::set_guard_mode(true);
+            arena_t* arena = ArenaAlloc(16 << ARENA_DEFAULT_PAGESIZE_SHIFT, 4 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            nvmem::set_guard_mode(false);
+            ASSERT(arena != nullptr);
+            ASSERT((arena->Flags & ARENA_FLAG_GUARD) != 0);
+
+            u8* bytes = (u8*)ArenaPush(arena, 16);
+            ASSERT(bytes != nullptr);
+            bytes[15] = 1;
+            ASSERT(StoreFaults(bytes + ((int_t)1 << ARENA_DEFAULT_PAGESIZE_SHIFT)));
+            ArenaRelease(arena);
+        }
+
+        UNITTEST_TEST(dirty_tracking_faults)
+        {
+            const int_t page  = (int_t)1 << ARENA_DEFAULT_PAGESIZE_SHIFT;
+            arena_t*    arena = ArenaAlloc(16 * page, 4 * page);
+            ASSERT(arena != nullptr);
+            u8* mem = (u8*)ArenaPush(arena, 4 * page);
+            ASSERT(ArenaDirtyTrack(arena));
+            dirty_runs_t runs = {};
+            ArenaDirtyCheckpoint(arena, CollectDirty, &runs);
+
+            // A store to a clean page is tracked, a store past the commited range still faults
+            ASSERT(!StoreFaults(mem));
+            ASSERT(arena->CapacityCommited == 4);
+            ASSERT(StoreFaults(mem + 8 * page));
+
+            ArenaDirtyUntrack(arena);
+            ArenaRelease(arena);
+        }
+#endif
     }
 }
 UNITTEST_SUITE_END
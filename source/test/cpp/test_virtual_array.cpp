@@ -0,0 +1,185 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_integer.h"
+#include "cbase/c_memory.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_array.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(virtual_array)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        struct entity_t
+        {
+            f32 m_pos[3];
+            u32 m_id;
+        };
+
+        // counts the live instances
+        static s32 s_alive = 0;
+        struct counted_t
+        {
+            counted_t()
+                : m_value(7)
+            {
+                ++s_alive;
+            }
+            counted_t(counted_t const& other)
+                : m_value(other.m_value)
+            {
+                ++s_alive;
+            }
+            ~counted_t() { --s_alive; }
+            u32 m_value;
+        };
+
+        UNITTEST_TEST(push_back_never_moves)
+        {
+            nvmem::array_t<entity_t> array;
+            CHECK_TRUE(array.setup(16, 1 << 20));
+            CHECK_TRUE(array.empty());
+
+            entity_t  e     = {{1.0f, 2.0f, 3.0f}, 0};
+            entity_t* first = array.push_back(e);
+            CHECK_EQUAL(array.data(), first);
+            for (u32 i = 1; i < 100000; ++i)
+            {
+                e.m_id = i;
+                CHECK_NOT_NULL(array.push_back(e));
+            }
+            CHECK_EQUAL(100000, array.size());
+            CHECK_TRUE(array.capacity() >= 100000);
+            CHECK_EQUAL(first, array.data());
+            CHECK_EQUAL(99999, array.back().m_id);
+            CHECK_EQUAL(5000, array[5000].m_id);
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(maximum)
+        {
+            nvmem::array_t<u32> array;
+            u32 const           max = nvmem::get_page_size() / sizeof(u32);
+            CHECK_TRUE(array.setup(0, max));
+            CHECK_EQUAL(max, array.max_capacity());
+            CHECK_TRUE(array.resize(max));
+            CHECK_NULL(array.push_back(1));
+            CHECK_TRUE(!array.resize(max + 1));
+            CHECK_EQUAL(max, array.size());
+        }
+
+        UNITTEST_TEST(resize_and_shrink)
+        {
+            nvmem::array_t<u32> array;
+            u32 const           per_page = nvmem::get_page_size() / sizeof(u32);
+            CHECK_TRUE(array.setup(0, 1 << 20));
+
+            CHECK_TRUE(array.resize(per_page * 8));
+            CHECK_EQUAL(0, array[0]);
+            CHECK_EQUAL(0, array[per_page * 8 - 1]);
+            nmem::memset(array.data(), 0xCD, per_page * 8 * sizeof(u32));
+
+            // Items that come back are value-initialized, also on pages that were in use
+            CHECK_TRUE(array.resize(per_page));
+            CHECK_TRUE(array.resize(per_page * 4));
+            CHECK_EQUAL(0xCDCDCDCD, array[per_page - 1]);
+            CHECK_EQUAL(0, array[per_page]);
+            CHECK_EQUAL(0, array[per_page * 4 - 1]);
+
+            CHECK_TRUE(array.resize(per_page * 2));
+            CHECK_TRUE(array.resize(per_page * 2 + 1, 5));
+            CHECK_TRUE(array.shrink_to_fit());
+            CHECK_EQUAL(per_page * 3, array.capacity());
+            CHECK_EQUAL(5, array.back());
+            CHECK_TRUE(array.resize(per_page * 8));
+            CHECK_EQUAL(0, array[per_page * 2 + 1]);
+            CHECK_EQUAL(0, array[per_page * 8 - 1]);
+            CHECK_EQUAL(1, array.commit_stats().decommit_count);
+
+            array.clear();
+            CHECK_TRUE(array.shrink_to_fit());
+            CHECK_EQUAL(0, array.capacity());
+            CHECK_NOT_NULL(array.push_back(3));
+        }
+
+        UNITTEST_TEST(resize_after_decommit)
+        {
+            // With ndecommit::Free the old content can still be there when a page is commited again
+            const nvmem::ndecommit::value_t mode = nvmem::get_decommit_mode();
+            nvmem::set_decommit_mode(nvmem::ndecommit::Free);
+
+            nvmem::array_t<u32> array;
+            CHECK_TRUE(array.setup(0, 1 << 20));
+            CHECK_TRUE(array.resize(100000));
+            nmem::memset(array.data(), 0xCD, 100000 * sizeof(u32));
+            CHECK_TRUE(array.resize(10));
+            CHECK_TRUE(array.shrink_to_fit());
+            CHECK_TRUE(array.resize(100000));
+
+            u32 dirty = 0;
+            for (u32 i = 10; i < 100000; ++i)
+                dirty += array[i] != 0 ? 1 : 0;
+            CHECK_EQUAL(0, dirty);
+
+            CHECK_TRUE(array.teardown());
+            nvmem::set_decommit_mode(mode);
+        }
+
+        UNITTEST_TEST(append)
+        {
+            nvmem::array_t<u32> array;
+            CHECK_TRUE(array.setup(0, 1 << 20));
+
+            u32 values[1000];
+            for (u32 i = 0; i < 1000; ++i)
+                values[i] = i;
+            for (u32 i = 0; i < 100; ++i)
+                CHECK_NOT_NULL(array.append(values, 1000));
+            CHECK_EQUAL(100000, array.size());
+            CHECK_EQUAL(999, array[99999]);
+            CHECK_EQUAL(500, array[50500]);
+
+            // Appending the array to itself, it does not move while growing
+            CHECK_NOT_NULL(array.append(array.data(), 1000));
+            CHECK_EQUAL(101000, array.size());
+            CHECK_EQUAL(999, array.back());
+
+            // All or nothing
+            CHECK_NULL(array.append(values, 0xffffffff));
+            CHECK_EQUAL(101000, array.size());
+        }
+
+        UNITTEST_TEST(construct_destruct)
+        {
+            s_alive = 0;
+            {
+                nvmem::array_t<counted_t> array;
+                CHECK_TRUE(array.setup(0, 65536));
+                CHECK_TRUE(array.resize(100));
+                CHECK_EQUAL(100, s_alive);
+                CHECK_EQUAL(7, array[99].m_value);
+
+                counted_t c;
+                c.m_value = 9;
+                array.push_back(c);
+                array.append(&c, 1);
+                CHECK_EQUAL(103, s_alive);
+                CHECK_EQUAL(9, array.back().m_value);
+
+                array.pop_back();
+                CHECK_TRUE(array.resize(50));
+                CHECK_EQUAL(51, s_alive);
+            }
+            CHECK_EQUAL(0, s_alive);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,132 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_integer.h"
+#include "cbase/c_memory.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_heap.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(virtual_heap)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(init_exit)
+        {
+            nvmem::heap_t heap;
+            CHECK_TRUE(heap.setup(16 * cMB));
+            CHECK_TRUE(heap.teardown());
+        }
+
+        UNITTEST_TEST(size_classes)
+        {
+            nvmem::heap_t heap;
+            CHECK_TRUE(heap.setup(16 * cMB));
+
+            alloc_t* allocator = &heap;
+            for (u32 size = 1; size <= 40000; size += 7)
+            {
+                u8* ptr = (u8*)allocator->allocate(size);
+                CHECK_NOT_NULL(ptr);
+                CHECK_EQUAL(0, (ptr_t)ptr & 15);
+                CHECK_TRUE(heap.usable_size(ptr) >= size);
+                CHECK_TRUE(heap.usable_size(ptr) <= size + size / 4 + 16 || size > 32768);
+                nmem::memset(ptr, 0xCD, size);
+                allocator->deallocate(ptr);
+            }
+
+            nvmem::heap_stats_t stats;
+            heap.get_stats(stats);
+            CHECK_EQUAL(0, stats.live_count);
+            CHECK_EQUAL(0, stats.live_bytes);
+            CHECK_EQUAL(0, stats.large_count);
+            CHECK_TRUE(heap.teardown());
+        }
+
+        UNITTEST_TEST(alignment)
+        {
+            nvmem::heap_t heap;
+            CHECK_TRUE(heap.setup(16 * cMB));
+
+            u32 const alignments[] = {16, 32, 64, 256, 4096, 8192, 16384, 32768, 65536};
+            for (u32 alignment : alignments)
+            {
+                void* small = heap.allocate(24, alignment);
+                void* large = heap.allocate(100000, alignment);
+                CHECK_EQUAL(0, (ptr_t)small & (alignment - 1));
+                CHECK_EQUAL(0, (ptr_t)large & (alignment - 1));
+                nmem::memset(large, 0xCD, 100000);
+                heap.deallocate(small);
+                heap.deallocate(large);
+            }
+            CHECK_TRUE(heap.teardown());
+        }
+
+        UNITTEST_TEST(pages_return)
+        {
+            nvmem::heap_t heap;
+            CHECK_TRUE(heap.setup(16 * cMB));
+
+            // 64 spans of 64 KiB with 64 byte items
+            static void* ptrs[65536];
+            for (u32 i = 0; i < 65536; ++i)
+            {
+                ptrs[i] = heap.allocate(64);
+                CHECK_NOT_NULL(ptrs[i]);
+            }
+
+            nvmem::heap_stats_t stats;
+            heap.get_stats(stats);
+            CHECK_EQUAL(65536, stats.live_count);
+            CHECK_EQUAL(64 * 65536, stats.live_bytes);
+            CHECK_EQUAL(64 * 65536, stats.commit_bytes);
+
+            // Empty spans are decommited except one, which is reused first
+            for (u32 i = 0; i < 65536; ++i)
+                heap.deallocate(ptrs[i]);
+            heap.get_stats(stats);
+            CHECK_EQUAL(0, stats.live_count);
+            CHECK_EQUAL(64 * 1024, stats.commit_bytes);
+
+            void* again = heap.allocate(64);
+            CHECK_NOT_NULL(again);
+            heap.get_stats(stats);
+            CHECK_EQUAL(64 * 1024, stats.commit_bytes);
+            CHECK_EQUAL(65537, stats.alloc_count);
+            heap.deallocate(again);
+
+            // Large allocations are released on deallocate, teardown releases the ones still in use
+            void* large = heap.allocate(1 * cMB);
+            heap.get_stats(stats);
+            CHECK_EQUAL(1, stats.large_count);
+            CHECK_TRUE(stats.commit_bytes >= 64 * 1024 + 1 * cMB);
+            heap.allocate(2 * cMB);
+            heap.deallocate(large);
+            heap.get_stats(stats);
+            CHECK_EQUAL(1, stats.large_count);
+            CHECK_TRUE(heap.teardown());
+        }
+
+        UNITTEST_TEST(exhausted)
+        {
+            nvmem::heap_t heap;
+            CHECK_TRUE(heap.setup(64 * cKB));
+
+            // One span per size class
+            void* ptrs[4];
+            for (u32 i = 0; i < 4; ++i)
+                ptrs[i] = heap.allocate(16384);
+            CHECK_NOT_NULL(ptrs[3]);
+            CHECK_NULL(heap.allocate(16384));
+            heap.deallocate(ptrs[0]);
+            CHECK_EQUAL(ptrs[0], heap.allocate(16384));
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -22,7 +22,6 @@ UNITTEST_SUITE_BEGIN(virtual_memory)
         UNITTEST_TEST(reserve_release)
         {
             u64   address_range = 4 * cGB;
-            u32   pagesize;
             void* baseptr;
             CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, baseptr));
             CHECK_TRUE(nvmem::release(baseptr, address_range));
@@ -33,7 +32,7 @@ UNITTEST_SUITE_BEGIN(virtual_memory)
         UNITTEST_TEST(commit_decommit)
         {
             u64   address_range = 4 * cGB;
-            u32   pagesize;
+            u32   pagesize      = nvmem::get_page_size();
             void* baseptr;
             CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, baseptr));
             CHECK_TRUE(nvmem::commit(baseptr, pagesize * 4));
@@ -45,6 +44,88 @@ UNITTEST_SUITE_BEGIN(virtual_memory)
             CHECK_TRUE(nvmem::decommit(baseptr, pagesize * 4));
             CHECK_TRUE(nvmem::release(baseptr, address_range));
         }
+
+        UNITTEST_TEST(decommit_returns_pages)
+        {
+            u64   address_range = 64 * cMB;
+            u32   pagesize      = nvmem::get_page_size();
+            void* baseptr;
+            CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, baseptr));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 4));
+            nmem::memset(baseptr, 0xCDCDCDCD, pagesize * 4);
+
+            // In DontNeed mode the pages are dropped, when commited again they read back as zero
+            CHECK_EQUAL(nvmem::ndecommit::DontNeed, nvmem::get_decommit_mode());
+            CHECK_TRUE(nvmem::decommit(baseptr, pagesize * 4));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 4));
+            CHECK_EQUAL(0, ((u8 const*)baseptr)[0]);
+            CHECK_EQUAL(0, ((u8 const*)baseptr)[pagesize * 4 - 1]);
+
+            // Free mode only hands the pages back lazily, the content after a new commit is undefined
+            nvmem::set_decommit_mode(nvmem::ndecommit::Free);
+            CHECK_EQUAL(nvmem::ndecommit::Free, nvmem::get_decommit_mode());
+            CHECK_TRUE(nvmem::decommit(baseptr, pagesize * 4));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 4));
+            nmem::memset(baseptr, 0, pagesize * 4);
+            nvmem::set_decommit_mode(nvmem::ndecommit::DontNeed);
+
+            CHECK_TRUE(nvmem::decommit(baseptr, pagesize * 4));
+            CHECK_TRUE(nvmem::release(baseptr, address_range));
+        }
+
+        UNITTEST_TEST(commit_populate)
+        {
+            u64   address_range = 64 * cMB;
+            u32   pagesize      = nvmem::get_page_size();
+            void* baseptr;
+            CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, baseptr));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 16, nvmem::ncommit::Populate));
+            CHECK_EQUAL(0, ((u8 const*)baseptr)[0]);
+            CHECK_EQUAL(0, ((u8 const*)baseptr)[pagesize * 16 - 1]);
+
+            // Populating pages that are in use keeps their content, large ranges are split over a few threads
+            nvmem::set_populate_threads(4, 1 * cMB);
+            CHECK_TRUE(nvmem::commit(baseptr, 8 * cMB));
+            nmem::memset(baseptr, 0xCD, 8 * cMB);
+            CHECK_TRUE(nvmem::populate(baseptr, 8 * cMB));
+            CHECK_EQUAL(0xCD, ((u8 const*)baseptr)[0]);
+            CHECK_EQUAL(0xCD, ((u8 const*)baseptr)[4 * cMB]);
+            CHECK_EQUAL(0xCD, ((u8 const*)baseptr)[8 * cMB - 1]);
+            nvmem::set_populate_threads(4, 16 * cMB);
+
+            CHECK_TRUE(nvmem::decommit(baseptr, 8 * cMB));
+            CHECK_TRUE(nvmem::release(baseptr, address_range));
+        }
+
+        UNITTEST_TEST(numa)
+        {
+            CHECK_TRUE(nvmem::numa_node_count() >= 1);
+
+            u64                   address_range = 64 * cMB;
+            u32                   pagesize      = nvmem::get_page_size();
+            void*                 baseptr;
+            nvmem::npage::value_t page_kind;
+            nvmem::numa_t         bind = {nvmem::nnuma::Bind, 1};
+            CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, 0, bind, baseptr, page_kind));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 16));
+            nmem::memset(baseptr, 0xCD, pagesize * 16);
+
+            // Node 0 always exists, on a system without NUMA support the node is unknown
+            s32 node = nvmem::query_node(baseptr);
+            CHECK_TRUE(node == 0 || node == -1);
+            u64 pages_per_node[4];
+            u64 backed = nvmem::query_nodes(baseptr, pagesize * 16, pages_per_node, 4);
+            CHECK_EQUAL(backed, pages_per_node[0]);
+
+            // Nodes that don't exist are ignored
+            nvmem::numa_t interleave = {nvmem::nnuma::Interleave, (u64)1 << 63};
+            CHECK_TRUE(nvmem::commit((u8*)baseptr + pagesize * 16, pagesize * 16, interleave));
+            nvmem::numa_t all = {nvmem::nnuma::Interleave, 0};
+            CHECK_TRUE(nvmem::numa_apply(baseptr, address_range, all));
+            CHECK_EQUAL(0xCD, ((u8 const*)baseptr)[pagesize * 16 - 1]);
+
+            CHECK_TRUE(nvmem::release(baseptr, address_range));
+        }
     }
 }
 UNITTEST_SUITE_END
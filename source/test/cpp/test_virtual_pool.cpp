@@ -7,6 +7,11 @@
 #include "cvmem/c_virtual_memory.h"
 #include "cvmem/c_virtual_pool.h"
 
+#if !defined(TARGET_PC)
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
+
 using namespace ncore;
 
 UNITTEST_SUITE_BEGIN(virtual_pool)
@@ -44,6 +49,329 @@ UNITTEST_SUITE_BEGIN(virtual_pool)
 
             array.teardown();
         }
+
+        UNITTEST_TEST(grow_on_demand)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(256, 65536));
+            array.set_grow_size(1024);
+
+            u32 const initial_cap = array.capacity();
+            entity_t* first       = array.allocate();
+            CHECK_EQUAL(first, array.ptr_at(0));
+            for (u32 i = 1; i < initial_cap; ++i)
+                array.allocate();
+            CHECK_EQUAL(initial_cap, array.capacity());
+
+            // The next allocation commits more pages, items do not move
+            entity_t* e = array.allocate();
+            CHECK_NOT_NULL(e);
+            CHECK_EQUAL(initial_cap, array.idx_of(e));
+            CHECK_TRUE(array.capacity() >= initial_cap + 1024);
+            CHECK_EQUAL(first, array.ptr_at(0));
+            e->m_alive = true;
+
+            // Grows up to the reserved maximum and then fails
+            while (array.allocate() != nullptr) {}
+            CHECK_EQUAL(array.max_capacity(), array.size());
+            CHECK_TRUE(array.size() >= 65536);
+
+            array.deallocate(e);
+            CHECK_EQUAL(e, array.allocate());
+
+            nvmem::pool_stats_t stats;
+            array.get_stats(stats);
+            CHECK_EQUAL(array.size() + 1, (u32)stats.alloc_count);
+            CHECK_EQUAL(array.size(), stats.peak_item_count);
+            CHECK_EQUAL(stats.page_max, stats.peak_page_count);
+            CHECK_TRUE(stats.commit_stats.commit_count > 1);
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(for_each_live)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(256, 65536));
+            CHECK_EQUAL(array.cInvalidIndex, array.first_live());
+
+            for (u32 i = 0; i < 1000; ++i)
+                array.allocate()->m_alive = true;
+            for (u32 i = 0; i < 1000; i += 3)
+                array.deallocate(array.ptr_at(i));
+            CHECK_TRUE(!array.is_live(0));
+            CHECK_TRUE(array.is_live(1));
+            CHECK_TRUE(!array.is_live(1000));
+
+            u32 count = 0;
+            u32 last  = 0;
+            array.for_each_live([&](entity_t* e, u32 index) {
+                CHECK_EQUAL(array.ptr_at(index), e);
+                CHECK_TRUE(index > last && (index % 3) != 0);
+                last = index;
+                ++count;
+            });
+            CHECK_EQUAL(array.size(), count);
+
+            u32 visited = 0;
+            for (u32 i = array.first_live(); i != array.cInvalidIndex; i = array.next_live(i))
+                ++visited;
+            CHECK_EQUAL(count, visited);
+            CHECK_EQUAL(1, array.first_live());
+            CHECK_EQUAL(998, array.next_live(997));
+
+            // Deallocate while iterating, a reused slot is live again
+            array.for_each_live([&](entity_t* e, u32) { array.deallocate(e); });
+            CHECK_EQUAL(0, array.size());
+            CHECK_EQUAL(array.cInvalidIndex, array.first_live());
+            entity_t* e = array.allocate();
+            CHECK_EQUAL(array.idx_of(e), array.first_live());
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(trim)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(0, 1 << 20));
+            u32 const per_page = nvmem::get_page_size() / sizeof(entity_t);
+
+            // A spike of 64 pages worth of items, then all but the first few are deallocated
+            static entity_t* items[64 * 1024];
+            u32 const        count = per_page * 64;
+            for (u32 i = 0; i < count; ++i)
+                items[i] = array.allocate();
+            for (u32 i = 10; i < count; ++i)
+                array.deallocate(items[i]);
+
+            nvmem::pool_stats_t stats;
+            array.get_stats(stats);
+            CHECK_EQUAL(64, stats.page_count);
+            CHECK_EQUAL(63, stats.empty_page_count);
+
+            CHECK_EQUAL(61, array.trim(2));
+            array.get_stats(stats);
+            CHECK_EQUAL(3, stats.page_count);
+            CHECK_EQUAL(2, stats.empty_page_count);
+            CHECK_EQUAL(61, stats.trim_page_count);
+            CHECK_EQUAL(1, stats.commit_stats.decommit_count);
+            CHECK_TRUE(array.capacity() < per_page * 4);
+
+            // The lowest free item is allocated first
+            CHECK_EQUAL(items[10], array.allocate());
+            array.deallocate(items[5]);
+            CHECK_EQUAL(items[5], array.allocate());
+
+            // Items on a trimmed page in between are commited again when they are allocated
+            for (u32 i = 11; i < per_page * 3; ++i)
+                array.allocate();
+            u32 const first = nvmem::get_page_size() / sizeof(entity_t);
+            u32 const last  = (nvmem::get_page_size() * 2 - 1) / sizeof(entity_t);
+            for (u32 i = first; i <= last; ++i)
+                array.deallocate(array.ptr_at(i));
+            CHECK_EQUAL(1, array.trim());
+            CHECK_TRUE(array.capacity() >= per_page * 3);
+            entity_t* e = array.allocate();
+            CHECK_EQUAL(array.ptr_at(first), e);
+            e->m_alive = true;
+            array.get_stats(stats);
+            CHECK_EQUAL(3, stats.page_count);
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(trim_threshold)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(0, 1 << 20));
+            u32 const per_page = nvmem::get_page_size() / sizeof(entity_t);
+            array.set_grow_size(per_page);
+            array.set_trim_threshold(per_page * 4);
+
+            for (u32 i = 0; i < per_page * 32; ++i)
+                array.allocate();
+            for (u32 i = per_page * 32; i > 0; --i)
+                array.deallocate(array.ptr_at(i - 1));
+
+            // Trimmed each time more than 1 + 4 pages were empty, the grow size is kept
+            nvmem::pool_stats_t stats;
+            array.get_stats(stats);
+            CHECK_EQUAL(0, stats.item_count);
+            CHECK_TRUE(stats.page_count <= 1 + 4 + 1);
+            CHECK_TRUE(stats.trim_page_count >= 32 - 6);
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(handles)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(256, 65536));
+            CHECK_NULL(array.try_get(nvmem::cInvalidHandle));
+
+            nvmem::handle_t handle;
+            entity_t*       e = array.allocate(handle);
+            CHECK_NOT_NULL(e);
+            CHECK_EQUAL(array.idx_of(e), nvmem::handle_index(handle));
+            CHECK_EQUAL(e, array.try_get(handle));
+            CHECK_EQUAL(handle, array.handle_of(e));
+
+            // The slot is reused, the old handle is stale
+            array.deallocate(handle);
+            CHECK_NULL(array.try_get(handle));
+            nvmem::handle_t again;
+            CHECK_EQUAL(e, array.allocate(again));
+            CHECK_EQUAL(nvmem::handle_index(handle), nvmem::handle_index(again));
+            CHECK_EQUAL(nvmem::handle_generation(handle) + 1, nvmem::handle_generation(again));
+            CHECK_NULL(array.try_get(handle));
+            CHECK_EQUAL(e, array.try_get(again));
+
+            // Deallocating through a stale handle does nothing
+            array.deallocate(handle);
+            CHECK_EQUAL(1, array.size());
+
+            // A handle of a slot that was never used and one beyond the capacity
+            CHECK_NULL(array.try_get(((nvmem::handle_t)0 << 32) | 100));
+            CHECK_NULL(array.try_get(((nvmem::handle_t)0 << 32) | 1000000));
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(batch)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(256, 65536));
+            array.set_grow_size(256);
+
+            entity_t* items[1000];
+            CHECK_EQUAL(1000, array.allocate_n(items, 1000));
+            CHECK_EQUAL(1000, array.size());
+            for (u32 i = 0; i < 1000; ++i)
+                CHECK_EQUAL(i, array.idx_of(items[i]));
+
+            // Free every other item, a batch allocate fills the holes lowest first
+            entity_t* odd[500];
+            for (u32 i = 0; i < 500; ++i)
+                odd[i] = items[i * 2 + 1];
+            array.deallocate_n(odd, 500);
+            CHECK_EQUAL(500, array.size());
+            CHECK_TRUE(array.is_live(0));
+            CHECK_TRUE(!array.is_live(1));
+
+            entity_t* again[600];
+            CHECK_EQUAL(600, array.allocate_n(again, 600));
+            for (u32 i = 0; i < 500; ++i)
+                CHECK_EQUAL(i * 2 + 1, array.idx_of(again[i]));
+            for (u32 i = 500; i < 600; ++i)
+                CHECK_EQUAL(i + 500, array.idx_of(again[i]));
+            CHECK_EQUAL(1100, array.size());
+
+            // A freed item is found again by a single allocate
+            array.deallocate_n(items, 1);
+            CHECK_EQUAL(items[0], array.allocate());
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(batch_full)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(64, 64));
+            const u32 max = array.max_capacity();
+
+            static entity_t* items[8192];
+            CHECK_TRUE(max + 10 <= 8192);
+            CHECK_EQUAL(max, array.allocate_n(items, max + 10));
+            CHECK_EQUAL(0, array.allocate_n(items, 1));
+            CHECK_NULL(array.allocate());
+
+            array.deallocate_n(items, max);
+            CHECK_EQUAL(0, array.size());
+            CHECK_EQUAL(max, array.allocate_n(items, max));
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        struct particle_t
+        {
+            f32 m_pos[3];
+            f32 m_vel[3];
+            u32 m_color;
+        };
+
+        UNITTEST_TEST(stride)
+        {
+            nvmem::pool_t<particle_t, 32> array;
+            CHECK_TRUE(array.setup(1024, 65536));
+
+            particle_t* a = array.allocate();
+            particle_t* b = array.allocate();
+            CHECK_EQUAL((u8*)a + 32, (u8*)b);
+            CHECK_EQUAL(1, array.idx_of(b));
+            CHECK_EQUAL(b, array.ptr_at(1));
+            CHECK_TRUE(array.max_capacity() >= 65536);
+
+            array.deallocate(a);
+            CHECK_EQUAL(a, array.allocate());
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(init_populate)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(4096, 65536, 0, nvmem::ncommit::Populate));
+            CHECK_TRUE(array.capacity() >= 4096);
+            array.set_grow_size(4096);
+
+            for (u32 i = 0; i <= 4096; ++i)
+                CHECK_NOT_NULL(array.allocate());
+            CHECK_TRUE(array.capacity() >= 8192);
+            CHECK_EQUAL(false, array.ptr_at(8191)->m_alive);
+
+            CHECK_TRUE(array.teardown());
+        }
+
+        UNITTEST_TEST(init_use_exit_huge_pages)
+        {
+            nvmem::pool_t<entity_t> array;
+            CHECK_TRUE(array.setup(4096, 1 << 20, 21));
+            CHECK_EQUAL(21, array.page_size_shift());
+            CHECK_TRUE(array.page_kind() >= nvmem::npage::Normal && array.page_kind() <= nvmem::npage::Huge);
+            CHECK_TRUE(array.capacity() >= 4096);
+
+            nmem::memset(array.ptr_at(0), 0xCDCDCDCD, sizeof(entity_t) * 4096);
+
+            CHECK_TRUE(array.teardown());
+        }
+
+#if !defined(TARGET_PC)
+        UNITTEST_TEST(guard_mode)
+        {
+            // A full pool of exactly one page, the item after the last one is on the guard page
+            nvmem::initialize();
+            const u32 count = nvmem::get_page_size() / sizeof(u64);
+            nvmem::set_guard_mode(true);
+            nvmem::pool_t<u64> array;
+            CHECK_TRUE(array.setup(count, count));
+            nvmem::set_guard_mode(false);
+            CHECK_EQUAL(count, array.max_capacity());
+            for (u32 i = 0; i < count; ++i)
+                *array.allocate() = i;
+
+            const pid_t pid = fork();
+            if (pid == 0)
+            {
+                *(volatile u64*)array.ptr_at(count) = 1;
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+            CHECK_TRUE(!WIFEXITED(status) || WEXITSTATUS(status) != 0);
+
+            CHECK_TRUE(array.teardown());
+        }
+#endif
     }
 }
 UNITTEST_SUITE_END
@@ -0,0 +1,91 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_integer.h"
+#include "cbase/c_memory.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_pool_concurrent.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(virtual_pool_concurrent)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        // 20 bytes
+        struct entity_t
+        {
+            f32  m_pos[3];
+            f32  m_speed;
+            bool m_alive;
+        };
+
+        UNITTEST_TEST(init_exit)
+        {
+            nvmem::cpool_t<entity_t> pool;
+            CHECK_TRUE(pool.setup(4096, 65536));
+            CHECK_TRUE(pool.capacity() >= 4096);
+            CHECK_EQUAL(65536, pool.max_capacity());
+            CHECK_TRUE(pool.teardown());
+        }
+
+        UNITTEST_TEST(allocate_deallocate)
+        {
+            nvmem::cpool_t<entity_t> pool;
+            CHECK_TRUE(pool.setup(256, 65536));
+
+            // Items are handed out in ascending order from the never used part of the pool
+            entity_t* a = pool.allocate();
+            entity_t* b = pool.allocate();
+            CHECK_EQUAL(pool.ptr_at(0), a);
+            CHECK_EQUAL(pool.ptr_at(1), b);
+            CHECK_EQUAL(1, pool.idx_of(b));
+
+            // A freed item comes back from the thread local magazine
+            pool.deallocate(a);
+            CHECK_EQUAL(a, pool.allocate());
+            pool.deallocate(a);
+            pool.deallocate(b);
+
+            CHECK_TRUE(pool.teardown());
+        }
+
+        UNITTEST_TEST(exhaust_and_recycle)
+        {
+            nvmem::cpool_t<entity_t> pool;
+            CHECK_TRUE(pool.setup(256, 8192));
+
+            // Grows up to the reserved maximum and then fails
+            static entity_t* items[8192];
+            for (u32 i = 0; i < 8192; ++i)
+            {
+                items[i] = pool.allocate();
+                CHECK_NOT_NULL(items[i]);
+                items[i]->m_alive = true;
+            }
+            CHECK_NULL(pool.allocate());
+            CHECK_EQUAL(8192, pool.capacity());
+
+            // Freeing everything moves full magazines to the depot, allocating again takes them back
+            for (u32 i = 0; i < 8192; ++i)
+                pool.deallocate(items[i]);
+            pool.flush();
+            for (u32 i = 0; i < 8192; ++i)
+            {
+                items[i] = pool.allocate();
+                CHECK_NOT_NULL(items[i]);
+            }
+            CHECK_NULL(pool.allocate());
+            for (u32 i = 0; i < 8192; ++i)
+                pool.deallocate(items[i]);
+
+            CHECK_TRUE(pool.teardown());
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,125 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_integer.h"
+#include "cbase/c_memory.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_arena.h"
+#include "cvmem/c_virtual_pool.h"
+#include "cvmem/c_virtual_reclaim.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(virtual_reclaim)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nvmem::initialize();
+            ArenasSetup(32, 1024);
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nvmem::reclaim_stop();
+            ArenasTeardown();
+        }
+
+        UNITTEST_TEST(not_running)
+        {
+            // Without the reclaimer the work is done on the calling thread
+            CHECK_TRUE(!nvmem::reclaim_running());
+
+            u64   address_range = 64 * cMB;
+            u32   pagesize      = nvmem::get_page_size();
+            void* baseptr;
+            CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, baseptr));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 4));
+            CHECK_EQUAL(0, nvmem::decommit_async(baseptr, pagesize * 4));
+            CHECK_EQUAL(0, nvmem::release_async(baseptr, address_range));
+            CHECK_TRUE(nvmem::reclaim_done(0));
+        }
+
+        UNITTEST_TEST(decommit_release)
+        {
+            CHECK_TRUE(nvmem::reclaim_start(16, 4));
+            CHECK_TRUE(nvmem::reclaim_running());
+
+            u64   address_range = 64 * cMB;
+            u32   pagesize      = nvmem::get_page_size();
+            void* baseptr;
+            CHECK_TRUE(nvmem::reserve(address_range, nvmem::nprotect::ReadWrite, baseptr));
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 64));
+            nmem::memset(baseptr, 0xCD, pagesize * 64);
+
+            // More requests than fit in the queue, the caller waits for room
+            u64 ticket = 0;
+            for (u32 i = 0; i < 64; ++i)
+                ticket = nvmem::decommit_async((u8*)baseptr + i * pagesize, pagesize);
+            CHECK_TRUE(ticket != 0);
+            nvmem::reclaim_wait(ticket);
+            CHECK_TRUE(nvmem::reclaim_done(ticket));
+
+            // Decommited pages read back as zero when commited again
+            CHECK_TRUE(nvmem::commit(baseptr, pagesize * 64));
+            CHECK_EQUAL(0, ((u8 const*)baseptr)[0]);
+            CHECK_EQUAL(0, ((u8 const*)baseptr)[pagesize * 64 - 1]);
+
+            nvmem::release_async(baseptr, address_range);
+            nvmem::reclaim_flush();
+
+            nvmem::reclaim_stats_t stats;
+            nvmem::reclaim_get_stats(stats);
+            CHECK_TRUE(stats.queued >= 65);
+            CHECK_EQUAL(stats.queued, stats.completed);
+            CHECK_EQUAL(0, stats.failures);
+            CHECK_TRUE(stats.decommit_bytes >= (u64)pagesize * 64);
+            CHECK_TRUE(stats.release_bytes >= address_range);
+        }
+
+        UNITTEST_TEST(arena_release)
+        {
+            CHECK_TRUE(nvmem::reclaim_start());
+
+            arena_t* arena = ArenaAlloc(1024 << ARENA_DEFAULT_PAGESIZE_SHIFT, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            nmem::memset(ArenaPush(arena, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT), 0xCD, 16 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+
+            // The decommit of a clear is done in the background, growing again waits for it
+            ArenaClear(arena);
+            CHECK_EQUAL(0, arena->CapacityCommited);
+            u8* ptr = (u8*)ArenaPush(arena, 8 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            CHECK_NOT_NULL(ptr);
+            nmem::memset(ptr, 0xCD, 8 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+
+            // The slot is reused only after the reclaimer released the memory
+            ArenaRelease(arena);
+            nvmem::reclaim_flush();
+            arena_t* again = ArenaAlloc(16 << ARENA_DEFAULT_PAGESIZE_SHIFT, 1 << ARENA_DEFAULT_PAGESIZE_SHIFT);
+            CHECK_EQUAL(arena, again);
+            ArenaRelease(again);
+        }
+
+        struct item_t
+        {
+            u64 m_value[4];
+        };
+
+        UNITTEST_TEST(pool_teardown)
+        {
+            CHECK_TRUE(nvmem::reclaim_start());
+
+            nvmem::pool_t<item_t> pool;
+            CHECK_TRUE(pool.setup(1024, 65536));
+            nmem::memset(pool.ptr_at(0), 0xCD, sizeof(item_t) * 1024);
+            CHECK_TRUE(pool.teardown());
+            nvmem::reclaim_flush();
+
+            nvmem::reclaim_stats_t stats;
+            nvmem::reclaim_get_stats(stats);
+            CHECK_EQUAL(stats.queued, stats.completed);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,147 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_integer.h"
+#include "cbase/c_memory.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cvmem/c_virtual_memory.h"
+#include "cvmem/c_virtual_ring.h"
+
+#include <thread>
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(virtual_ring)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nvmem::initialize();
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(mirror)
+        {
+            u64   size    = 1;
+            void* baseptr = nullptr;
+            CHECK_TRUE(nvmem::mirror_alloc(size, baseptr));
+            CHECK_EQUAL((u64)nvmem::get_allocation_granularity(), size);
+
+            u8* lower = (u8*)baseptr;
+            u8* upper = lower + size;
+            lower[0]  = 0x12;
+            CHECK_EQUAL(0x12, upper[0]);
+            upper[size - 1] = 0x34;
+            CHECK_EQUAL(0x34, lower[size - 1]);
+
+            CHECK_TRUE(nvmem::mirror_release(baseptr, size));
+        }
+
+        UNITTEST_TEST(wrap_around)
+        {
+            nvmem::ring_t ring;
+            CHECK_TRUE(ring.setup(100));
+            const u32 capacity = ring.capacity();
+            CHECK_TRUE(capacity >= 100 && (capacity & (capacity - 1)) == 0);
+
+            // move the positions close to the end so the next record straddles it
+            const u32 skip = capacity - 10;
+            CHECK_NOT_NULL(ring.write_begin(skip));
+            ring.write_end(skip);
+            u32 avail = 0;
+            ring.read_begin(avail);
+            CHECK_EQUAL(skip, avail);
+            ring.read_end(avail);
+
+            u8* dst = ring.write_begin(64);
+            CHECK_NOT_NULL(dst);
+            for (u32 i = 0; i < 64; ++i)
+                dst[i] = (u8)i;
+            ring.write_end(64);
+            CHECK_EQUAL(64, ring.size());
+
+            u8 const* src = ring.read_begin(avail);
+            CHECK_EQUAL(64, avail);
+            bool same = true;
+            for (u32 i = 0; i < 64; ++i)
+                same = same && src[i] == (u8)i;
+            CHECK_TRUE(same);
+            ring.read_end(avail);
+            CHECK_EQUAL(0, ring.size());
+
+            CHECK_TRUE(ring.teardown());
+            CHECK_TRUE(ring.teardown()); // nothing to do
+        }
+
+        UNITTEST_TEST(full)
+        {
+            nvmem::ring_t ring;
+            CHECK_TRUE(ring.setup(4096));
+            const u32 capacity = ring.capacity();
+
+            CHECK_NULL(ring.write_begin(capacity + 1));
+            CHECK_NOT_NULL(ring.write_begin(capacity));
+            ring.write_end(capacity - 16);
+            CHECK_NULL(ring.write_begin(32));
+            CHECK_NOT_NULL(ring.write_begin(16));
+
+            u32 avail = 0;
+            ring.read_begin(avail);
+            ring.read_end(32);
+            CHECK_NOT_NULL(ring.write_begin(48));
+
+            CHECK_TRUE(ring.teardown());
+        }
+
+        UNITTEST_TEST(producer_consumer)
+        {
+            nvmem::ring_t ring;
+            CHECK_TRUE(ring.setup(65536));
+
+            // records of varying size, a u32 length followed by bytes derived from the record number
+            const u32 num_records = 100000;
+            std::thread producer([&ring, num_records]() {
+                for (u32 r = 0; r < num_records; ++r)
+                {
+                    const u32 length = 4 + (r * 37) % 1000;
+                    u8*       dst;
+                    while ((dst = ring.write_begin(length)) == nullptr)
+                        std::this_thread::yield();
+                    *(u32*)dst = length;
+                    for (u32 i = 4; i < length; ++i)
+                        dst[i] = (u8)(r + i);
+                    ring.write_end(length);
+                }
+            });
+
+            u32  received = 0;
+            bool ok       = true;
+            while (received < num_records)
+            {
+                u32       avail = 0;
+                u8 const* src   = ring.read_begin(avail);
+                u32       used  = 0;
+                while (avail - used >= 4 && avail - used >= *(u32 const*)(src + used))
+                {
+                    const u32 length = *(u32 const*)(src + used);
+                    ok               = ok && length == 4 + (received * 37) % 1000;
+                    for (u32 i = 4; i < length && ok; ++i)
+                        ok = src[used + i] == (u8)(received + i);
+                    used += length;
+                    received += 1;
+                }
+                if (used == 0)
+                    std::this_thread::yield();
+                ring.read_end(used);
+            }
+            producer.join();
+
+            CHECK_TRUE(ok);
+            CHECK_EQUAL(0, ring.size());
+            CHECK_TRUE(ring.teardown());
+        }
+    }
+}
+UNITTEST_SUITE_END